@@ -0,0 +1,39 @@
+
+#include <stdlib.h>
+#include <stddef.h>
+
+#include <new>
+
+#include "AllocHook.h"
+
+//
+// The replaced global operator new and delete of the allocation counter, see AllocHook.h.
+//
+#if defined(INVOICE_ALLOC_HOOK) && INVOICE_ALLOC_HOOK
+
+size_t & alloc_hook_counter() {
+    static thread_local size_t alloc_count = 0;
+    return alloc_count;
+}
+
+void * operator new (size_t size) {
+    alloc_hook_counter()++;
+    void * ptr = malloc((size != 0) ? size : 1);
+    if (ptr == nullptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void * operator new[] (size_t size) {
+    return operator new(size);
+}
+
+void operator delete (void * ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete[] (void * ptr) noexcept {
+    free(ptr);
+}
+
+#endif // INVOICE_ALLOC_HOOK
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <new>
+
+//
+// Heap allocation counter for checking that the search loops never allocate.
+//
+// It's only compiled in with INVOICE_ALLOC_HOOK (cmake -DINVOICE_ALLOC_HOOK=ON), and it
+// replaces the global operator new. The replacement lives in AllocHook.cpp, which is a
+// source of the library, so any number of translation units may include this file.
+// The counter is per thread, so the parallel workers can check themselves.
+//
+#if defined(INVOICE_ALLOC_HOOK) && INVOICE_ALLOC_HOOK
+
+// Defined in AllocHook.cpp, with the replaced operator new and delete.
+size_t & alloc_hook_counter();
+
+static inline size_t alloc_hook_count() {
+    return alloc_hook_counter();
+}
+
+// Aborts if the current thread has allocated since alloc_hook_count() returned start_count.
+static inline void alloc_hook_verify(size_t start_count, const char * where) {
+    size_t alloc_count = alloc_hook_counter() - start_count;
+    if (alloc_count != 0) {
+        fprintf(stderr, " %s: %u heap allocation(s) after warm-up.\n", where, (uint32_t)alloc_count);
+        abort();
+    }
+}
+
+#else
+
+static inline size_t alloc_hook_count() {
+    return 0;
+}
+
+static inline void alloc_hook_verify(size_t start_count, const char * where) {
+    (void)start_count;
+    (void)where;
+}
+
+#endif // INVOICE_ALLOC_HOOK
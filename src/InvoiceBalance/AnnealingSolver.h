@@ -0,0 +1,313 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+#include <assert.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include "Random.h"
+#include "ExactSolver.h"
+#include "CancelToken.h"
+
+//
+// The local search of a near miss: an answer of the same problem as ExactSolver (ExactItem
+// bounds, ExactChoice answer) which is a few cents off the target is moved step by step,
+// instead of being thrown away for another restart. The moves are:
+//
+//   nudge      one price by +-1 cent, the total moves by its count
+//   step       one count by +-1, the total moves by its price
+//   transfer   k (1..kMaxTransfer) counts from one goods to another, k * (price_i - price_j)
+//   swap       the price adjustments (price - input price) of two goods
+//
+// A move to an error (|total - target| in cents) which isn't larger is always taken, a worse
+// one with the probability exp(-(worse - error) / temperature) of simulated annealing. The
+// temperature falls geometrically to below a cent in kCycleSteps steps, from about the size
+// of a price nudge (or of a count step in every other cycle, which moves the counts), then
+// the next cycle starts again from the best answer so far. The
+// counts and the prices stay in their bounds, the input price is the middle of the band.
+//
+class AnnealingSolver
+{
+public:
+    static const uint64_t kMaxSteps = uint64_t(1) << 18;
+    static const uint64_t kCycleSteps = uint64_t(1) << 14;
+    static const int64_t kMaxTransfer = 4;
+
+    struct Move {
+        enum {
+            Nudge,
+            Step,
+            Transfer,
+            Swap,
+            Count
+        };
+    };
+
+private:
+    std::vector<int64_t>    prices_;
+    std::vector<int64_t>    counts_;
+    std::vector<int64_t>    base_prices_;
+    std::vector<int64_t>    min_prices_;
+    std::vector<int64_t>    max_prices_;
+    std::vector<int64_t>    min_counts_;
+    std::vector<int64_t>    max_counts_;    // clipped by the target if unlimited
+
+    std::vector<int64_t>    best_prices_;
+    std::vector<int64_t>    best_counts_;
+
+    uint64_t                max_steps_;
+    uint64_t                steps_;
+    int64_t                 start_error_;
+    int64_t                 best_error_;
+
+    bool                                    has_deadline_;
+    std::chrono::steady_clock::time_point   deadline_;
+    const CancelToken *                     cancel_token_;
+
+public:
+    AnnealingSolver() : max_steps_(kMaxSteps), steps_(0), start_error_(0), best_error_(0),
+                        has_deadline_(false), cancel_token_(nullptr) {
+    }
+
+    ~AnnealingSolver() {
+    }
+
+    void set_deadline(std::chrono::steady_clock::time_point deadline) {
+        this->has_deadline_ = true;
+        this->deadline_ = deadline;
+    }
+
+    void clear_deadline() {
+        this->has_deadline_ = false;
+    }
+
+    void set_cancel_token(const CancelToken * cancel_token) {
+        this->cancel_token_ = cancel_token;
+    }
+
+    // solve() returns ExactStatus::TooLarge after max_steps moves.
+    void set_max_steps(uint64_t max_steps) {
+        this->max_steps_ = (max_steps > 0) ? max_steps : 1;
+    }
+
+    // The moves tried by the last solve().
+    uint64_t step_count() const {
+        return this->steps_;
+    }
+
+    // The error of the start answer and of the best answer of the last solve(), in cents.
+    int64_t start_error() const {
+        return this->start_error_;
+    }
+
+    int64_t best_error() const {
+        return this->best_error_;
+    }
+
+    //
+    // Moves from start (clamped into the bounds) toward the target. answer is the best
+    // answer found (empty if the items have no answer at all), the status is Found if it's
+    // exact, else ExactStatus::TooLarge (out of steps) or Timeout.
+    //
+    int solve(int64_t target, const std::vector<ExactItem> & items, const std::vector<ExactChoice> & start,
+              RandomGenerator & random, std::vector<ExactChoice> & answer) {
+        answer.clear();
+        this->steps_ = 0;
+        if (items.empty() || start.size() != items.size() || target <= 0 || !this->load_items(target, items, start))
+            return ExactStatus::TooLarge;
+
+        size_t n = items.size();
+        int64_t rest = target;
+        for (size_t i = 0; i < n; i++) {
+            rest -= this->prices_[i] * this->counts_[i];
+        }
+        this->start_error_ = (rest >= 0) ? rest : -rest;
+        this->best_error_ = this->start_error_;
+        this->best_prices_ = this->prices_;
+        this->best_counts_ = this->counts_;
+
+        // The cycles start hot enough for an average price nudge and for an average count
+        // step in turn, the hotter ones try the other counts.
+        double start_temperatures[2] = { 1.0, 1.0 };
+        for (size_t i = 0; i < n; i++) {
+            start_temperatures[0] += (double)this->counts_[i] / (double)n;
+            start_temperatures[1] += (double)this->prices_[i] / (double)n;
+        }
+        const double end_temperature = 0.25;
+        double coolings[2];
+        for (size_t c = 0; c < 2; c++) {
+            coolings[c] = pow(end_temperature / start_temperatures[c], 1.0 / (double)kCycleSteps);
+        }
+
+        int status = ExactStatus::TooLarge;
+        size_t cycle = 0;
+        double temperature = start_temperatures[0];
+        while (this->best_error_ != 0) {
+            if (this->steps_ >= this->max_steps_) {
+                status = ExactStatus::TooLarge;
+                break;
+            }
+            if ((this->steps_ & 0xFFF) == 0 && this->is_timeout()) {
+                status = ExactStatus::Timeout;
+                break;
+            }
+            if ((this->steps_ % kCycleSteps) == 0 && this->steps_ != 0) {
+                // Reheat from the best answer.
+                this->prices_ = this->best_prices_;
+                this->counts_ = this->best_counts_;
+                rest = target - this->total();
+                cycle = (cycle + 1) & 1;
+                temperature = start_temperatures[cycle];
+            }
+            this->steps_++;
+            this->step(rest, temperature, random);
+            temperature *= coolings[cycle];
+        }
+        if (this->best_error_ == 0)
+            status = ExactStatus::Found;
+
+        answer.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            answer[i] = ExactChoice(this->best_prices_[i], this->best_counts_[i]);
+        }
+        return status;
+    }
+
+private:
+    bool is_timeout() const {
+        if (this->cancel_token_ != nullptr && this->cancel_token_->is_cancelled())
+            return true;
+        return (this->has_deadline_ && std::chrono::steady_clock::now() >= this->deadline_);
+    }
+
+    bool load_items(int64_t target, const std::vector<ExactItem> & items, const std::vector<ExactChoice> & start) {
+        size_t n = items.size();
+        this->prices_.resize(n);
+        this->counts_.resize(n);
+        this->base_prices_.resize(n);
+        this->min_prices_.resize(n);
+        this->max_prices_.resize(n);
+        this->min_counts_.resize(n);
+        this->max_counts_.resize(n);
+
+        for (size_t i = 0; i < n; i++) {
+            const ExactItem & item = items[i];
+            int64_t min_price = (std::max)(item.min_price, int64_t(1));
+            int64_t max_price = item.max_price;
+            if (max_price < min_price)
+                return false;
+            int64_t min_count = (std::max)(item.min_count, int64_t(1));
+            int64_t max_count = (std::max)(target / min_price, min_count);
+            if (item.max_count >= min_count && item.max_count < max_count)
+                max_count = item.max_count;
+            this->base_prices_[i] = (item.min_price + item.max_price) / 2;
+            this->min_prices_[i] = min_price;
+            this->max_prices_[i] = max_price;
+            this->min_counts_[i] = min_count;
+            this->max_counts_[i] = max_count;
+            this->prices_[i] = (std::min)((std::max)(start[i].price, min_price), max_price);
+            this->counts_[i] = (std::min)((std::max)(start[i].count, min_count), max_count);
+        }
+        return true;
+    }
+
+    int64_t total() const {
+        int64_t total = 0;
+        for (size_t i = 0; i < this->prices_.size(); i++) {
+            total += this->prices_[i] * this->counts_[i];
+        }
+        return total;
+    }
+
+    bool in_price_band(size_t i, int64_t price) const {
+        return (price >= this->min_prices_[i] && price <= this->max_prices_[i]);
+    }
+
+    bool in_count_range(size_t i, int64_t count) const {
+        return (count >= this->min_counts_[i] && count <= this->max_counts_[i]);
+    }
+
+    // Tries one random move, rest is target - total.
+    void step(int64_t & rest, double temperature, RandomGenerator & random) {
+        size_t n = this->prices_.size();
+        size_t i = (size_t)random.next_random_64(0, n - 1);
+        size_t j = i;
+        int move = (int)(random.next_random32() % (uint32_t)((n >= 2) ? Move::Count : Move::Transfer));
+        if (move >= Move::Transfer) {
+            j = (size_t)random.next_random_64(0, n - 2);
+            if (j >= i)
+                j++;
+        }
+
+        // The change of the total, and the new prices and counts of i and j.
+        int64_t delta;
+        int64_t price_i = this->prices_[i], price_j = this->prices_[j];
+        int64_t count_i = this->counts_[i], count_j = this->counts_[j];
+        switch (move) {
+        case Move::Nudge: {
+            int64_t dir = (random.next_random32() & 1) ? 1 : -1;
+            price_i += dir;
+            if (!this->in_price_band(i, price_i))
+                return;
+            delta = dir * count_i;
+            break;
+        }
+        case Move::Step: {
+            int64_t dir = (random.next_random32() & 1) ? 1 : -1;
+            count_i += dir;
+            if (!this->in_count_range(i, count_i))
+                return;
+            delta = dir * price_i;
+            break;
+        }
+        case Move::Transfer: {
+            int64_t k = random.next_random_i64(1, kMaxTransfer);
+            count_i += k;
+            count_j -= k;
+            if (!this->in_count_range(i, count_i) || !this->in_count_range(j, count_j))
+                return;
+            delta = k * (price_i - price_j);
+            break;
+        }
+        default: {
+            int64_t adjust_i = price_i - this->base_prices_[i];
+            int64_t adjust_j = price_j - this->base_prices_[j];
+            if (adjust_i == adjust_j)
+                return;
+            price_i = this->base_prices_[i] + adjust_j;
+            price_j = this->base_prices_[j] + adjust_i;
+            if (!this->in_price_band(i, price_i) || !this->in_price_band(j, price_j))
+                return;
+            delta = (adjust_j - adjust_i) * (count_i - count_j);
+            break;
+        }
+        }
+
+        int64_t error = (rest >= 0) ? rest : -rest;
+        int64_t new_rest = rest - delta;
+        int64_t new_error = (new_rest >= 0) ? new_rest : -new_rest;
+        if (new_error > error) {
+            if (random.next_random_f() >= exp((double)(error - new_error) / temperature))
+                return;
+        }
+
+        this->prices_[i] = price_i;
+        this->counts_[i] = count_i;
+        if (j != i) {
+            this->prices_[j] = price_j;
+            this->counts_[j] = count_j;
+        }
+        rest = new_rest;
+        if (new_error < this->best_error_) {
+            this->best_error_ = new_error;
+            this->best_prices_ = this->prices_;
+            this->best_counts_ = this->counts_;
+        }
+    }
+};
@@ -0,0 +1,241 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include "ExactSolver.h"
+
+//
+// Depth-first branch-and-bound solver of the same problem as ExactSolver (ExactItem in,
+// ExactChoice out, ExactStatus back), it uses no bitsets, so the size of the total doesn't
+// matter, only how well the bounds cut the tree.
+//
+// The goods are tried from the most expensive one down. Each goods contributes a value in
+// [min_count * min_price, max_count * max_price], so the goods after the k-th one can only
+// reach [rest_min[k], rest_max[k]]. At every node the count range and then the price band
+// of the goods are narrowed to the values that keep the rest of the target in that interval,
+// so a subtree is cut as soon as the target leaves it. The cheapest goods is not branched
+// on: the rest must be count * price, which is tested by division.
+//
+// If the whole tree is cut, there is no answer. The tree can still be too large on loose
+// bounds, so the search gives up after kMaxNodes nodes (ExactStatus::TooLarge).
+//
+class BranchBoundSolver
+{
+public:
+    static const uint64_t kMaxNodes = uint64_t(1) << 32;
+
+private:
+    struct Item {
+        size_t  index;
+        int64_t min_price;
+        int64_t max_price;
+        int64_t min_count;
+        int64_t max_count;
+    };
+
+    std::vector<Item>           items_;
+    std::vector<int64_t>        rest_min_;
+    std::vector<int64_t>        rest_max_;
+    std::vector<ExactChoice>    choices_;
+
+    uint64_t    node_count_;
+    int         status_;
+
+    bool                                    has_deadline_;
+    std::chrono::steady_clock::time_point   deadline_;
+    const CancelToken *                     cancel_token_;
+
+    static int64_t div_floor(int64_t a, int64_t b) {
+        assert(b > 0);
+        return ((a >= 0) ? (a / b) : -((-a + b - 1) / b));
+    }
+
+    static int64_t div_ceil(int64_t a, int64_t b) {
+        assert(b > 0);
+        return ((a >= 0) ? ((a + b - 1) / b) : -((-a) / b));
+    }
+
+public:
+    BranchBoundSolver() : node_count_(0), status_(ExactStatus::Infeasible), has_deadline_(false),
+                          cancel_token_(nullptr) {
+    }
+
+    ~BranchBoundSolver() {
+    }
+
+    void set_deadline(std::chrono::steady_clock::time_point deadline) {
+        this->has_deadline_ = true;
+        this->deadline_ = deadline;
+    }
+
+    void clear_deadline() {
+        this->has_deadline_ = false;
+    }
+
+    // solve() returns ExactStatus::Timeout if cancel_token is cancelled (nullptr is none).
+    void set_cancel_token(const CancelToken * cancel_token) {
+        this->cancel_token_ = cancel_token;
+    }
+
+    // The nodes visited by the last solve().
+    uint64_t node_count() const {
+        return this->node_count_;
+    }
+
+    int solve(int64_t target, const std::vector<ExactItem> & exact_items,
+              std::vector<ExactChoice> & answer) {
+        answer.clear();
+        this->node_count_ = 0;
+        if (exact_items.empty() || target <= 0)
+            return ExactStatus::Infeasible;
+
+        if (!this->prepare_items(target, exact_items))
+            return ExactStatus::Infeasible;
+        if (target < this->rest_min_[0] || target > this->rest_max_[0])
+            return ExactStatus::Infeasible;
+
+        this->status_ = ExactStatus::Infeasible;
+        if (this->branch(0, target)) {
+            answer.resize(this->items_.size());
+            for (size_t k = 0; k < this->items_.size(); k++) {
+                answer[this->items_[k].index] = this->choices_[k];
+            }
+            return ExactStatus::Found;
+        }
+        return this->status_;
+    }
+
+private:
+    bool prepare_items(int64_t target, const std::vector<ExactItem> & exact_items) {
+        size_t n = exact_items.size();
+        this->items_.resize(n);
+
+        int64_t min_total = 0;
+        for (size_t i = 0; i < n; i++) {
+            const ExactItem & src = exact_items[i];
+            Item & item = this->items_[i];
+            item.index = i;
+            item.min_price = (std::max)(src.min_price, int64_t(1));
+            item.max_price = src.max_price;
+            item.min_count = (std::max)(src.min_count, int64_t(1));
+            item.max_count = src.max_count;
+            if (item.min_price > item.max_price)
+                return false;
+            min_total += item.min_count * item.min_price;
+        }
+        if (min_total > target)
+            return false;
+
+        // Clip the counts by what is left of the target after the other goods take their minimum.
+        for (size_t i = 0; i < n; i++) {
+            Item & item = this->items_[i];
+            int64_t others = min_total - item.min_count * item.min_price;
+            int64_t max_count = (target - others) / item.min_price;
+            if (item.max_count <= 0 || item.max_count > max_count)
+                item.max_count = max_count;
+            if (item.min_count > item.max_count)
+                return false;
+        }
+
+        std::sort(this->items_.begin(), this->items_.end(), [](const Item & lhs, const Item & rhs) {
+            return (lhs.max_price > rhs.max_price);
+        });
+
+        // rest_min_[k], rest_max_[k]: what the goods from k on can contribute.
+        this->rest_min_.assign(n + 1, 0);
+        this->rest_max_.assign(n + 1, 0);
+        for (ptrdiff_t k = (ptrdiff_t)n - 1; k >= 0; k--) {
+            const Item & item = this->items_[k];
+            this->rest_min_[k] = this->rest_min_[k + 1] + item.min_count * item.min_price;
+            this->rest_max_[k] = this->rest_max_[k + 1] + item.max_count * item.max_price;
+        }
+        this->choices_.resize(n);
+        return true;
+    }
+
+    // Counts a node, false if the search has to give up (status_ tells why).
+    bool visit_node() {
+        this->node_count_++;
+        if ((this->node_count_ & 0xFFFF) == 0) {
+            if (this->node_count_ >= kMaxNodes) {
+                this->status_ = ExactStatus::TooLarge;
+                return false;
+            }
+            if ((this->cancel_token_ != nullptr && this->cancel_token_->is_cancelled())
+                || (this->has_deadline_ && std::chrono::steady_clock::now() >= this->deadline_)) {
+                this->status_ = ExactStatus::Timeout;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool giving_up() const {
+        return (this->status_ != ExactStatus::Infeasible);
+    }
+
+    // The goods from k on sum to remain, which is in [rest_min_[k], rest_max_[k]].
+    bool branch(size_t k, int64_t remain) {
+        if (!this->visit_node())
+            return false;
+
+        const Item & item = this->items_[k];
+        if (k + 1 == this->items_.size())
+            return this->solve_last(item, remain, this->choices_[k]);
+
+        // count * price must be in [remain - rest_max, remain - rest_min].
+        int64_t low = remain - this->rest_max_[k + 1];
+        int64_t high = remain - this->rest_min_[k + 1];
+        int64_t min_count = (std::max)(item.min_count, div_ceil(low, item.max_price));
+        int64_t max_count = (std::min)(item.max_count, div_floor(high, item.min_price));
+        for (int64_t count = min_count; count <= max_count; count++) {
+            int64_t min_price = (std::max)(item.min_price, div_ceil(low, count));
+            int64_t max_price = (std::min)(item.max_price, div_floor(high, count));
+            for (int64_t price = min_price; price <= max_price; price++) {
+                if (this->branch(k + 1, remain - count * price)) {
+                    this->choices_[k] = ExactChoice(price, count);
+                    return true;
+                }
+                if (this->giving_up())
+                    return false;
+            }
+        }
+        return false;
+    }
+
+    // count * price == remain, on the shorter of the count range and the price band.
+    bool solve_last(const Item & item, int64_t remain, ExactChoice & choice) const {
+        int64_t min_count = (std::max)(item.min_count, div_ceil(remain, item.max_price));
+        int64_t max_count = (std::min)(item.max_count, remain / item.min_price);
+        int64_t min_price = (std::max)(item.min_price, div_ceil(remain, max_count));
+        int64_t max_price = (std::min)(item.max_price, remain / min_count);
+        if (min_count > max_count || min_price > max_price)
+            return false;
+
+        if (max_price - min_price <= max_count - min_count) {
+            for (int64_t price = min_price; price <= max_price; price++) {
+                if (remain % price == 0) {
+                    choice = ExactChoice(price, remain / price);
+                    return true;
+                }
+            }
+        }
+        else {
+            for (int64_t count = min_count; count <= max_count; count++) {
+                if (remain % count == 0) {
+                    choice = ExactChoice(remain / count, count);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <atomic>
+
+//
+// The cooperative cancellation of a search: whoever is done (a perfect answer, a good enough
+// answer, the deadline) cancels it, and every search loop checks it where it checks its
+// deadline and gives up. Nothing is interrupted, the searches stop at their next check.
+//
+class CancelToken
+{
+private:
+    std::atomic<bool>   cancelled_;
+
+    CancelToken(const CancelToken &) = delete;
+    CancelToken & operator = (const CancelToken &) = delete;
+
+public:
+    CancelToken() : cancelled_(false) {
+    }
+
+    void cancel() {
+        this->cancelled_.store(true, std::memory_order_release);
+    }
+
+    void reset() {
+        this->cancelled_.store(false, std::memory_order_release);
+    }
+
+    // Cheap enough for the restart loops, it's a relaxed load.
+    bool is_cancelled() const {
+        return this->cancelled_.load(std::memory_order_relaxed);
+    }
+};
@@ -0,0 +1,332 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+#include <assert.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <vector>
+#include <limits>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define BATCH_KERNEL_X86    1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#include <immintrin.h>
+#endif
+
+#if defined(BATCH_KERNEL_X86) && (defined(__GNUC__) || defined(__clang__))
+#define BATCH_TARGET_SSE41  __attribute__((target("sse4.1")))
+#define BATCH_TARGET_AVX    __attribute__((target("avx")))
+#else
+#define BATCH_TARGET_SSE41
+#define BATCH_TARGET_AVX
+#endif
+
+//
+// K candidates of the random search in structure-of-arrays layout: the price and the count
+// of goods i of candidate k are at [i * K + k]. The padding goods of a candidate has count 0.
+//
+// All values are integer cents stored in doubles, they are exact below 2^53, so the kernels
+// can use the packed double instructions of SSE4.1 and AVX for every step.
+//
+struct CandidateBatch {
+    static const size_t kBatchSize = 64;
+
+    size_t  goods_count;
+    size_t  size;               // the number of candidates filled in
+    double  total_amount;
+
+    // Per goods: the price band [min_price, max_price].
+    std::vector<double> min_prices;
+    std::vector<double> max_prices;
+
+    // Per goods and candidate: [goods * kBatchSize + candidate]
+    std::vector<double> prices;
+    std::vector<double> counts;
+
+    // Per candidate
+    std::vector<double> padding_prices;
+    std::vector<double> padding_mins;
+    std::vector<double> padding_maxs;
+
+    // Output per candidate: the padding count, the smallest error (invalid_error() if the
+    // padding count is out of range) and the goods whose price is adjusted (-1 is none).
+    std::vector<double> padding_counts;
+    std::vector<double> errors;
+    std::vector<double> adjust_indexes;
+
+    CandidateBatch() : goods_count(0), size(0), total_amount(0.0) {
+    }
+
+    static double invalid_error() {
+        return (std::numeric_limits<double>::max)();
+    }
+
+    void resize(size_t goods_count) {
+        this->goods_count = goods_count;
+        this->size = 0;
+        this->min_prices.resize(goods_count);
+        this->max_prices.resize(goods_count);
+        this->prices.resize(goods_count * kBatchSize);
+        this->counts.resize(goods_count * kBatchSize);
+        this->padding_prices.resize(kBatchSize);
+        this->padding_mins.resize(kBatchSize);
+        this->padding_maxs.resize(kBatchSize);
+        this->padding_counts.resize(kBatchSize);
+        this->errors.resize(kBatchSize);
+        this->adjust_indexes.resize(kBatchSize);
+    }
+
+    bool full() const {
+        return (this->size >= kBatchSize);
+    }
+
+    double & price(size_t goods, size_t candidate) {
+        return this->prices[goods * kBatchSize + candidate];
+    }
+
+    double & count(size_t goods, size_t candidate) {
+        return this->counts[goods * kBatchSize + candidate];
+    }
+};
+
+typedef void (*BatchKernel)(CandidateBatch & batch);
+
+//
+// Evaluates one candidate: the total of the non-padding goods, the residual to the total
+// amount, the padding count, and the best single-goods price adjustment of the remainder.
+//
+static inline void evaluate_candidate_scalar(CandidateBatch & batch, size_t k)
+{
+    const size_t K = CandidateBatch::kBatchSize;
+    size_t n = batch.goods_count;
+
+    double total = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        total += batch.prices[i * K + k] * batch.counts[i * K + k];
+    }
+    double residual = batch.total_amount - total;
+    double padding_price = batch.padding_prices[k];
+    double padding_count = floor(residual / padding_price);
+    double remainder = residual - padding_count * padding_price;
+    if (remainder < 0.0) {
+        padding_count -= 1.0;
+        remainder += padding_price;
+    }
+    else if (remainder >= padding_price) {
+        padding_count += 1.0;
+        remainder -= padding_price;
+    }
+
+    bool valid = (residual >= 0.0 && padding_count >= batch.padding_mins[k] &&
+                  padding_count <= batch.padding_maxs[k]);
+
+    double best_error = remainder;
+    double best_index = -1.0;
+    if (valid) {
+        for (size_t i = 0; i < n; i++) {
+            double count = batch.counts[i * K + k];
+            if (count == 0.0)
+                count = padding_count;
+            double adjust = floor(remainder / count + 0.5);
+            double new_price = batch.prices[i * K + k] + adjust;
+            double error = fabs(remainder - adjust * count);
+            if (new_price >= batch.min_prices[i] && new_price <= batch.max_prices[i] && error < best_error) {
+                best_error = error;
+                best_index = (double)i;
+            }
+        }
+    }
+
+    batch.padding_counts[k] = padding_count;
+    batch.errors[k] = (valid ? best_error : CandidateBatch::invalid_error());
+    batch.adjust_indexes[k] = best_index;
+}
+
+static void evaluate_batch_scalar(CandidateBatch & batch)
+{
+    for (size_t k = 0; k < batch.size; k++) {
+        evaluate_candidate_scalar(batch, k);
+    }
+}
+
+#if defined(BATCH_KERNEL_X86)
+
+BATCH_TARGET_SSE41
+static void evaluate_batch_sse41(CandidateBatch & batch)
+{
+    const size_t K = CandidateBatch::kBatchSize;
+    size_t n = batch.goods_count;
+
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d one = _mm_set1_pd(1.0);
+    const __m128d half = _mm_set1_pd(0.5);
+    const __m128d sign_mask = _mm_set1_pd(-0.0);
+    const __m128d total_amount = _mm_set1_pd(batch.total_amount);
+    const __m128d invalid = _mm_set1_pd(CandidateBatch::invalid_error());
+
+    size_t k = 0;
+    for (; k + 2 <= batch.size; k += 2) {
+        __m128d total = zero;
+        for (size_t i = 0; i < n; i++) {
+            __m128d price = _mm_loadu_pd(&batch.prices[i * K + k]);
+            __m128d count = _mm_loadu_pd(&batch.counts[i * K + k]);
+            total = _mm_add_pd(total, _mm_mul_pd(price, count));
+        }
+        __m128d residual = _mm_sub_pd(total_amount, total);
+        __m128d padding_price = _mm_loadu_pd(&batch.padding_prices[k]);
+        __m128d padding_count = _mm_floor_pd(_mm_div_pd(residual, padding_price));
+        __m128d remainder = _mm_sub_pd(residual, _mm_mul_pd(padding_count, padding_price));
+
+        // Fix the rounding of the division
+        __m128d mask = _mm_cmplt_pd(remainder, zero);
+        padding_count = _mm_sub_pd(padding_count, _mm_and_pd(mask, one));
+        remainder = _mm_add_pd(remainder, _mm_and_pd(mask, padding_price));
+        mask = _mm_cmpge_pd(remainder, padding_price);
+        padding_count = _mm_add_pd(padding_count, _mm_and_pd(mask, one));
+        remainder = _mm_sub_pd(remainder, _mm_and_pd(mask, padding_price));
+
+        __m128d valid = _mm_cmpge_pd(residual, zero);
+        valid = _mm_and_pd(valid, _mm_cmpge_pd(padding_count, _mm_loadu_pd(&batch.padding_mins[k])));
+        valid = _mm_and_pd(valid, _mm_cmple_pd(padding_count, _mm_loadu_pd(&batch.padding_maxs[k])));
+
+        __m128d best_error = remainder;
+        __m128d best_index = _mm_set1_pd(-1.0);
+        for (size_t i = 0; i < n; i++) {
+            __m128d price = _mm_loadu_pd(&batch.prices[i * K + k]);
+            __m128d count = _mm_loadu_pd(&batch.counts[i * K + k]);
+            count = _mm_blendv_pd(count, padding_count, _mm_cmpeq_pd(count, zero));
+            __m128d adjust = _mm_floor_pd(_mm_add_pd(_mm_div_pd(remainder, count), half));
+            __m128d new_price = _mm_add_pd(price, adjust);
+            __m128d error = _mm_andnot_pd(sign_mask, _mm_sub_pd(remainder, _mm_mul_pd(adjust, count)));
+            __m128d better = _mm_cmpge_pd(new_price, _mm_set1_pd(batch.min_prices[i]));
+            better = _mm_and_pd(better, _mm_cmple_pd(new_price, _mm_set1_pd(batch.max_prices[i])));
+            better = _mm_and_pd(better, _mm_cmplt_pd(error, best_error));
+            best_error = _mm_blendv_pd(best_error, error, better);
+            best_index = _mm_blendv_pd(best_index, _mm_set1_pd((double)i), better);
+        }
+
+        _mm_storeu_pd(&batch.padding_counts[k], padding_count);
+        _mm_storeu_pd(&batch.errors[k], _mm_blendv_pd(invalid, best_error, valid));
+        _mm_storeu_pd(&batch.adjust_indexes[k], _mm_blendv_pd(_mm_set1_pd(-1.0), best_index, valid));
+    }
+
+    for (; k < batch.size; k++) {
+        evaluate_candidate_scalar(batch, k);
+    }
+}
+
+BATCH_TARGET_AVX
+static void evaluate_batch_avx(CandidateBatch & batch)
+{
+    const size_t K = CandidateBatch::kBatchSize;
+    size_t n = batch.goods_count;
+
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d half = _mm256_set1_pd(0.5);
+    const __m256d sign_mask = _mm256_set1_pd(-0.0);
+    const __m256d total_amount = _mm256_set1_pd(batch.total_amount);
+    const __m256d invalid = _mm256_set1_pd(CandidateBatch::invalid_error());
+
+    size_t k = 0;
+    for (; k + 4 <= batch.size; k += 4) {
+        __m256d total = zero;
+        for (size_t i = 0; i < n; i++) {
+            __m256d price = _mm256_loadu_pd(&batch.prices[i * K + k]);
+            __m256d count = _mm256_loadu_pd(&batch.counts[i * K + k]);
+            total = _mm256_add_pd(total, _mm256_mul_pd(price, count));
+        }
+        __m256d residual = _mm256_sub_pd(total_amount, total);
+        __m256d padding_price = _mm256_loadu_pd(&batch.padding_prices[k]);
+        __m256d padding_count = _mm256_floor_pd(_mm256_div_pd(residual, padding_price));
+        __m256d remainder = _mm256_sub_pd(residual, _mm256_mul_pd(padding_count, padding_price));
+
+        // Fix the rounding of the division
+        __m256d mask = _mm256_cmp_pd(remainder, zero, _CMP_LT_OQ);
+        padding_count = _mm256_sub_pd(padding_count, _mm256_and_pd(mask, one));
+        remainder = _mm256_add_pd(remainder, _mm256_and_pd(mask, padding_price));
+        mask = _mm256_cmp_pd(remainder, padding_price, _CMP_GE_OQ);
+        padding_count = _mm256_add_pd(padding_count, _mm256_and_pd(mask, one));
+        remainder = _mm256_sub_pd(remainder, _mm256_and_pd(mask, padding_price));
+
+        __m256d valid = _mm256_cmp_pd(residual, zero, _CMP_GE_OQ);
+        valid = _mm256_and_pd(valid, _mm256_cmp_pd(padding_count, _mm256_loadu_pd(&batch.padding_mins[k]), _CMP_GE_OQ));
+        valid = _mm256_and_pd(valid, _mm256_cmp_pd(padding_count, _mm256_loadu_pd(&batch.padding_maxs[k]), _CMP_LE_OQ));
+
+        __m256d best_error = remainder;
+        __m256d best_index = _mm256_set1_pd(-1.0);
+        for (size_t i = 0; i < n; i++) {
+            __m256d price = _mm256_loadu_pd(&batch.prices[i * K + k]);
+            __m256d count = _mm256_loadu_pd(&batch.counts[i * K + k]);
+            count = _mm256_blendv_pd(count, padding_count, _mm256_cmp_pd(count, zero, _CMP_EQ_OQ));
+            __m256d adjust = _mm256_floor_pd(_mm256_add_pd(_mm256_div_pd(remainder, count), half));
+            __m256d new_price = _mm256_add_pd(price, adjust);
+            __m256d error = _mm256_andnot_pd(sign_mask, _mm256_sub_pd(remainder, _mm256_mul_pd(adjust, count)));
+            __m256d better = _mm256_cmp_pd(new_price, _mm256_set1_pd(batch.min_prices[i]), _CMP_GE_OQ);
+            better = _mm256_and_pd(better, _mm256_cmp_pd(new_price, _mm256_set1_pd(batch.max_prices[i]), _CMP_LE_OQ));
+            better = _mm256_and_pd(better, _mm256_cmp_pd(error, best_error, _CMP_LT_OQ));
+            best_error = _mm256_blendv_pd(best_error, error, better);
+            best_index = _mm256_blendv_pd(best_index, _mm256_set1_pd((double)i), better);
+        }
+
+        _mm256_storeu_pd(&batch.padding_counts[k], padding_count);
+        _mm256_storeu_pd(&batch.errors[k], _mm256_blendv_pd(invalid, best_error, valid));
+        _mm256_storeu_pd(&batch.adjust_indexes[k], _mm256_blendv_pd(_mm256_set1_pd(-1.0), best_index, valid));
+    }
+
+    for (; k < batch.size; k++) {
+        evaluate_candidate_scalar(batch, k);
+    }
+}
+
+static bool cpu_has_sse41()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return ((info[2] & (1 << 19)) != 0);
+#else
+    return (__builtin_cpu_supports("sse4.1") != 0);
+#endif
+}
+
+static bool cpu_has_avx()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    // AVX and OSXSAVE, then the OS must save the YMM registers.
+    if ((info[2] & (1 << 28)) == 0 || (info[2] & (1 << 27)) == 0)
+        return false;
+    return ((_xgetbv(0) & 0x6) == 0x6);
+#else
+    return (__builtin_cpu_supports("avx") != 0);
+#endif
+}
+
+#endif // BATCH_KERNEL_X86
+
+//
+// Picks the widest kernel the CPU supports, the scalar one is always available.
+//
+static BatchKernel select_batch_kernel(const char ** name = nullptr)
+{
+#if defined(BATCH_KERNEL_X86)
+    if (cpu_has_avx()) {
+        if (name) *name = "avx";
+        return evaluate_batch_avx;
+    }
+    if (cpu_has_sse41()) {
+        if (name) *name = "sse4.1";
+        return evaluate_batch_sse41;
+    }
+#endif
+    if (name) *name = "scalar";
+    return evaluate_batch_scalar;
+}
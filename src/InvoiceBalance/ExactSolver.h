@@ -0,0 +1,444 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <chrono>
+
+#include "SumBitSet.h"
+#include "CancelToken.h"
+
+//
+// One goods line of the exact solver, all the prices are in cents.
+//
+struct ExactItem {
+    int64_t min_price;
+    int64_t max_price;
+    int64_t min_count;
+    int64_t max_count;      // 0 is unlimited
+
+    ExactItem() : min_price(0), max_price(0), min_count(1), max_count(0) {}
+    ExactItem(int64_t min_price, int64_t max_price, int64_t min_count, int64_t max_count)
+        : min_price(min_price), max_price(max_price), min_count(min_count), max_count(max_count) {}
+};
+
+struct ExactChoice {
+    int64_t price;
+    int64_t count;
+
+    ExactChoice() : price(0), count(0) {}
+    ExactChoice(int64_t price, int64_t count) : price(price), count(count) {}
+};
+
+struct ExactStatus {
+    enum {
+        Found,
+        Infeasible,
+        TooLarge,
+        Timeout
+    };
+};
+
+//
+// Exact solver of: sum(count[i] * price[i]) == target, with
+//
+//     price[i] in [min_price, max_price], count[i] in [min_count, max_count].
+//
+// It's a reachable-sum DP over bitsets, stage k holds every total that the first k goods
+// (in the solving order) can reach, the last goods is only tested by membership. If the
+// last stage can't reach the target, there is no answer at all.
+//
+// begin_enumerate() and next_answer() walk back through the same stages to yield every
+// distinct answer one by one, the walk only keeps one cursor per goods (no answer list).
+//
+class ExactSolver
+{
+public:
+    // The limit of the memory used by the stage bitsets.
+    static const size_t kMaxMemoryBytes = size_t(1024) * 1024 * 1024;
+
+protected:
+    struct Item {
+        size_t  index;
+        int64_t min_price;
+        int64_t max_price;
+        int64_t min_count;
+        int64_t max_count;
+
+        int64_t price_terms() const { return (this->max_price - this->min_price + 1); }
+        int64_t count_terms() const { return (this->max_count - this->min_count + 1); }
+        int64_t choices() const { return (this->price_terms() * this->count_terms()); }
+    };
+
+    // The enumeration position of one goods: the rest of the target it and the goods before
+    // it must reach, and the next (count, price) to test.
+    struct Cursor {
+        int64_t remain;
+        int64_t count;
+        int64_t price;
+    };
+
+    int64_t                 target_;
+    std::vector<Item>       items_;
+    std::vector<SumBitSet>  stages_;
+    SumBitSet               scratch_;
+
+    // Stage -1: only the empty sum.
+    SumBitSet               origin_;
+
+    std::vector<Cursor>     cursors_;
+    std::vector<ExactChoice> choices_;
+    size_t                  depth_;
+    size_t                  steps_;
+    bool                    enumerating_;
+    bool                    timed_out_;
+
+    bool                                    has_deadline_;
+    std::chrono::steady_clock::time_point   deadline_;
+    const CancelToken *                     cancel_token_;
+
+    static int64_t log2_ceil(int64_t n) {
+        int64_t bits = 0;
+        while ((int64_t(1) << bits) < n)
+            bits++;
+        return bits;
+    }
+
+public:
+    ExactSolver() : target_(0), depth_(0), steps_(0), enumerating_(false), timed_out_(false),
+                    has_deadline_(false), cancel_token_(nullptr) {
+        this->origin_.reset(0, 0);
+        this->origin_.set(0);
+    }
+
+    ~ExactSolver() {
+    }
+
+    // solve() returns ExactStatus::Timeout if it isn't done at the deadline, and next_answer()
+    // stops there too (see timed_out()).
+    void set_deadline(std::chrono::steady_clock::time_point deadline) {
+        this->has_deadline_ = true;
+        this->deadline_ = deadline;
+    }
+
+    void clear_deadline() {
+        this->has_deadline_ = false;
+    }
+
+    // solve() returns ExactStatus::Timeout too if cancel_token is cancelled (nullptr is none).
+    void set_cancel_token(const CancelToken * cancel_token) {
+        this->cancel_token_ = cancel_token;
+    }
+
+    int solve(int64_t target, const std::vector<ExactItem> & exact_items,
+              std::vector<ExactChoice> & answer) {
+        answer.clear();
+        this->enumerating_ = false;
+        int status = this->build_stages(target, exact_items);
+        if (status != ExactStatus::Found)
+            return status;
+
+        size_t n = this->items_.size();
+        answer.resize(n);
+        int64_t remain = target;
+        for (ptrdiff_t k = (ptrdiff_t)n - 1; k >= 0; k--) {
+            const Item & item = this->items_[k];
+            ExactChoice choice;
+            bool found = this->find_choice(this->stage_before(k), item, remain, choice);
+            if (!found) {
+                // Only the last goods can miss, the stages before it are all reachable.
+                assert(k == (ptrdiff_t)n - 1);
+                answer.clear();
+                return ExactStatus::Infeasible;
+            }
+            answer[item.index] = choice;
+            remain -= choice.count * choice.price;
+        }
+        assert(remain == 0);
+        return ExactStatus::Found;
+    }
+
+    //
+    // Starts the enumeration of all the answers, then next_answer() yields them one by one.
+    // Returns ExactStatus::Found if the stages are built, even if there is no answer.
+    //
+    int begin_enumerate(int64_t target, const std::vector<ExactItem> & exact_items) {
+        this->enumerating_ = false;
+        this->timed_out_ = false;
+        int status = this->build_stages(target, exact_items);
+        if (status != ExactStatus::Found)
+            return status;
+
+        size_t n = this->items_.size();
+        this->cursors_.resize(n);
+        this->choices_.resize(n);
+        this->depth_ = 0;
+        this->steps_ = 0;
+        this->start_cursor(0, target);
+        this->enumerating_ = true;
+        return ExactStatus::Found;
+    }
+
+    //
+    // The next distinct answer (in the order of the items), returns false when they are
+    // all done, or at the deadline (or the cancel token), then timed_out() is true.
+    // The answers are in a depth-first order, not sorted.
+    //
+    bool next_answer(std::vector<ExactChoice> & answer) {
+        if (!this->enumerating_)
+            return false;
+
+        size_t n = this->items_.size();
+        for (;;) {
+            // The clock is only read once every 256 steps, a step is one next_choice().
+            if ((++this->steps_ & 0xFF) == 0 && this->is_timeout()) {
+                this->enumerating_ = false;
+                this->timed_out_ = true;
+                return false;
+            }
+            size_t depth = this->depth_;
+            size_t k = n - 1 - depth;
+            ExactChoice & choice = this->choices_[k];
+            if (this->next_choice(k, this->cursors_[depth], choice)) {
+                if (depth + 1 == n) {
+                    answer.resize(n);
+                    for (size_t i = 0; i < n; i++) {
+                        answer[this->items_[i].index] = this->choices_[i];
+                    }
+                    return true;
+                }
+                this->depth_++;
+                this->start_cursor(this->depth_, this->cursors_[depth].remain - choice.count * choice.price);
+            }
+            else {
+                if (depth == 0) {
+                    this->enumerating_ = false;
+                    return false;
+                }
+                this->depth_--;
+            }
+        }
+    }
+
+    // True if the last enumeration stopped at the deadline before all the answers were yielded.
+    bool timed_out() const {
+        return this->timed_out_;
+    }
+
+protected:
+    bool is_timeout() const {
+        if (this->cancel_token_ != nullptr && this->cancel_token_->is_cancelled())
+            return true;
+        return (this->has_deadline_ && std::chrono::steady_clock::now() >= this->deadline_);
+    }
+
+    // The stage that the items before items_[k] can reach.
+    const SumBitSet & stage_before(size_t k) const {
+        return ((k == 0) ? this->origin_ : this->stages_[k - 1]);
+    }
+
+    // Builds the stages of all the items but the last one, returns ExactStatus::Found if done.
+    int build_stages(int64_t target, const std::vector<ExactItem> & exact_items) {
+        this->target_ = target;
+
+        size_t n = exact_items.size();
+        if (n == 0 || target <= 0)
+            return ExactStatus::Infeasible;
+
+        if (!this->prepare_items(exact_items))
+            return ExactStatus::Infeasible;
+
+        // max_rest[k]: the most that the items after k can contribute.
+        std::vector<int64_t> min_rest(n + 1, 0), max_rest(n + 1, 0);
+        for (ptrdiff_t k = (ptrdiff_t)n - 1; k >= 0; k--) {
+            const Item & item = this->items_[k];
+            min_rest[k] = min_rest[k + 1] + item.min_count * item.min_price;
+            max_rest[k] = max_rest[k + 1] + item.max_count * item.max_price;
+        }
+        if (target < min_rest[0] || target > max_rest[0])
+            return ExactStatus::Infeasible;
+
+        size_t total_bytes = 0;
+        // The stage bitsets are kept between the calls, they are reset() before use.
+        if (this->stages_.size() < n - 1)
+            this->stages_.resize(n - 1);
+        for (size_t k = 0; k + 1 < n; k++) {
+            const SumBitSet & prev = this->stage_before(k);
+            const Item & item = this->items_[k];
+            int64_t first = (std::max)(prev.first() + item.min_count * item.min_price,
+                                       target - max_rest[k + 1]);
+            int64_t last = (std::min)(prev.last() + item.max_count * item.max_price,
+                                      target - min_rest[k + 1]);
+            if (first > last)
+                return ExactStatus::Infeasible;
+
+            total_bytes += (size_t)((last - first) / 8 + 8);
+            if (total_bytes > kMaxMemoryBytes)
+                return ExactStatus::TooLarge;
+
+            SumBitSet & next = this->stages_[k];
+            next.reset(first, last);
+            if (!this->add_item(prev, item, next))
+                return ExactStatus::Timeout;
+            if (!next.any())
+                return ExactStatus::Infeasible;
+        }
+        return ExactStatus::Found;
+    }
+
+    void start_cursor(size_t depth, int64_t remain) {
+        const Item & item = this->items_[this->items_.size() - 1 - depth];
+        Cursor & cursor = this->cursors_[depth];
+        cursor.remain = remain;
+        cursor.count = item.min_count;
+        cursor.price = item.min_price;
+    }
+
+    //
+    // The next (count, price) of items_[k] from the cursor on, that leaves a rest which the
+    // items before it can reach. The cursor is moved past the choice.
+    //
+    bool next_choice(size_t k, Cursor & cursor, ExactChoice & choice) {
+        const SumBitSet & stage = this->stage_before(k);
+        const Item & item = this->items_[k];
+        while (cursor.count <= item.max_count) {
+            if (cursor.remain - cursor.count * item.min_price < stage.first())
+                break;
+            // The prices that leave more than the stage can reach are skipped at once.
+            int64_t over = cursor.remain - stage.last();
+            if (over > 0) {
+                int64_t min_price = (over + cursor.count - 1) / cursor.count;
+                if (cursor.price < min_price)
+                    cursor.price = min_price;
+            }
+            while (cursor.price <= item.max_price) {
+                int64_t price = cursor.price++;
+                int64_t rest = cursor.remain - cursor.count * price;
+                if (rest < stage.first())
+                    break;
+                if (stage.test(rest)) {
+                    choice.price = price;
+                    choice.count = cursor.count;
+                    return true;
+                }
+            }
+            cursor.count++;
+            cursor.price = item.min_price;
+        }
+        cursor.count = item.max_count + 1;
+        return false;
+    }
+
+    bool prepare_items(const std::vector<ExactItem> & exact_items) {
+        size_t n = exact_items.size();
+        this->items_.resize(n);
+
+        int64_t min_total = 0;
+        for (size_t i = 0; i < n; i++) {
+            const ExactItem & src = exact_items[i];
+            Item & item = this->items_[i];
+            item.index = i;
+            item.min_price = (std::max)(src.min_price, int64_t(1));
+            item.max_price = src.max_price;
+            item.min_count = (std::max)(src.min_count, int64_t(1));
+            item.max_count = src.max_count;
+            if (item.min_price > item.max_price)
+                return false;
+            min_total += item.min_count * item.min_price;
+        }
+        if (min_total > this->target_)
+            return false;
+
+        // Clip the counts by what is left of the target after the other goods take their minimum.
+        for (size_t i = 0; i < n; i++) {
+            Item & item = this->items_[i];
+            int64_t others = min_total - item.min_count * item.min_price;
+            int64_t max_count = (this->target_ - others) / item.min_price;
+            if (item.max_count <= 0 || item.max_count > max_count)
+                item.max_count = max_count;
+            if (item.min_count > item.max_count)
+                return false;
+        }
+
+        // The goods with the most choices is the cheapest one to test last.
+        std::sort(this->items_.begin(), this->items_.end(), [](const Item & lhs, const Item & rhs) {
+            return (lhs.choices() < rhs.choices());
+        });
+        return true;
+    }
+
+    //
+    // next |= prev + { count * price }, for all the counts and prices of the item.
+    // Returns false if the deadline has passed.
+    //
+    bool add_item(const SumBitSet & prev, const Item & item, SumBitSet & next) {
+        return add_item(prev, item, next, this->scratch_);
+    }
+
+    // The same, with the scratch bitset of the caller (for the threads of a subclass).
+    bool add_item(const SumBitSet & prev, const Item & item, SumBitSet & next, SumBitSet & scratch) const {
+        int64_t price_terms = item.price_terms();
+        int64_t count_terms = item.count_terms();
+
+        // Estimate the number of bitset passes: one dilation for each price, or one for each count.
+        int64_t width = next.size();
+        int64_t by_price_steps = ((count_terms - 1) * item.min_price >= width)
+                               ? 1 : log2_ceil(count_terms);
+        int64_t by_price_cost = price_terms * (by_price_steps + 2);
+        int64_t by_count_cost = count_terms * (log2_ceil(price_terms) + 2);
+
+        if (by_price_cost <= by_count_cost) {
+            for (int64_t price = item.min_price; price <= item.max_price; price++) {
+                if (this->is_timeout())
+                    return false;
+                int64_t shift = item.min_count * price;
+                int64_t last = (std::min)(prev.last() + (count_terms - 1) * price, next.last() - shift);
+                if (last < prev.first())
+                    break;
+                scratch.reset(prev.first(), last);
+                scratch.or_shifted(prev, 0);
+                scratch.dilate(price, count_terms);
+                next.or_shifted(scratch, shift);
+            }
+        }
+        else {
+            for (int64_t count = item.min_count; count <= item.max_count; count++) {
+                if (this->is_timeout())
+                    return false;
+                int64_t shift = count * item.min_price;
+                int64_t last = (std::min)(prev.last() + (price_terms - 1) * count, next.last() - shift);
+                if (last < prev.first())
+                    break;
+                scratch.reset(prev.first(), last);
+                scratch.or_shifted(prev, 0);
+                scratch.dilate(count, price_terms);
+                next.or_shifted(scratch, shift);
+            }
+        }
+        return true;
+    }
+
+    bool find_choice(const SumBitSet & stage, const Item & item, int64_t remain, ExactChoice & choice) {
+        for (int64_t count = item.min_count; count <= item.max_count; count++) {
+            if (remain - count * item.min_price < stage.first())
+                break;
+            for (int64_t price = item.min_price; price <= item.max_price; price++) {
+                int64_t rest = remain - count * price;
+                if (rest < stage.first())
+                    break;
+                if (stage.test(rest)) {
+                    choice.price = price;
+                    choice.count = count;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+};
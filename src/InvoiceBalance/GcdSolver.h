@@ -0,0 +1,363 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <chrono>
+
+#include "ExactSolver.h"
+
+//
+// Closed-form solver of the invoices with 2 or 3 goods, the same problem as ExactSolver
+// (ExactItem in, ExactChoice out, ExactStatus back).
+//
+// With the prices fixed, two goods are the linear Diophantine equation c1 * p1 + c2 * p2 = T:
+// it has integer answers iff g = gcd(p1, p2) divides T, and they are c1 = c0 + k * (p2 / g)
+// for the c0 of the extended Euclid, so the count ranges of both goods are one interval of
+// c1 to test, O(log p) per price pair. The price pairs are tried from the input prices out,
+// so the first answer changes the prices the least.
+//
+// Three goods loop over the count of the goods with the fewest counts (and over its prices)
+// and solve the other two goods as above, the counts of that goods are stepped by the
+// modulus that keeps the rest divisible by gcd(p1, p2).
+//
+// It's exhaustive, so ExactStatus::Infeasible is a proof, but it gives up after kMaxSteps
+// pair solves (ExactStatus::TooLarge, see set_max_steps()), and at the deadline.
+//
+class GcdSolver
+{
+public:
+    static const size_t kMinGoods = 2;
+    static const size_t kMaxGoods = 3;
+
+    static const uint64_t kMaxSteps = uint64_t(1) << 26;
+
+    // The products of the modular steps must fit in 63 bits.
+    static const int64_t kMaxPrice = int64_t(1) << 31;
+
+private:
+    struct Item {
+        size_t  index;
+        int64_t min_price;
+        int64_t max_price;
+        int64_t min_count;
+        int64_t max_count;
+        int64_t center;         // the middle of the price band
+    };
+
+    Item        items_[kMaxGoods];
+    size_t      item_count_;
+    uint64_t    steps_;
+    uint64_t    max_steps_;
+    int         status_;
+
+    bool                                    has_deadline_;
+    std::chrono::steady_clock::time_point   deadline_;
+
+    static int64_t div_floor(int64_t a, int64_t b) {
+        return ((a >= 0) ? (a / b) : -((-a + b - 1) / b));
+    }
+
+    static int64_t div_ceil(int64_t a, int64_t b) {
+        return ((a >= 0) ? ((a + b - 1) / b) : -((-a) / b));
+    }
+
+    // a * x + b * y == gcd(a, b), for a, b > 0.
+    static int64_t extended_gcd(int64_t a, int64_t b, int64_t & x, int64_t & y) {
+        int64_t x0 = 1, y0 = 0, x1 = 0, y1 = 1;
+        while (b != 0) {
+            int64_t q = a / b;
+            int64_t t = a - q * b;
+            a = b;
+            b = t;
+            t = x0 - q * x1;
+            x0 = x1;
+            x1 = t;
+            t = y0 - q * y1;
+            y0 = y1;
+            y1 = t;
+        }
+        x = x0;
+        y = y0;
+        return a;
+    }
+
+    static int64_t gcd(int64_t a, int64_t b) {
+        while (b != 0) {
+            int64_t t = a % b;
+            a = b;
+            b = t;
+        }
+        return a;
+    }
+
+    static int64_t mod(int64_t a, int64_t m) {
+        int64_t r = a % m;
+        return ((r < 0) ? (r + m) : r);
+    }
+
+    // The k-th price of the band from the center out: center, center + 1, center - 1, ...
+    static int64_t nth_price(const Item & item, int64_t k) {
+        int64_t offset = (k + 1) / 2;
+        return ((k & 1) ? (item.center + offset) : (item.center - offset));
+    }
+
+    static int64_t price_terms(const Item & item) {
+        // Enough terms to cover the wider side of the band from the center.
+        int64_t wide = (std::max)(item.max_price - item.center, item.center - item.min_price);
+        return (wide * 2 + 1);
+    }
+
+    static bool price_in_band(const Item & item, int64_t price) {
+        return (price >= item.min_price && price <= item.max_price);
+    }
+
+public:
+    GcdSolver() : item_count_(0), steps_(0), max_steps_(kMaxSteps), status_(ExactStatus::Infeasible),
+                  has_deadline_(false) {
+    }
+
+    ~GcdSolver() {
+    }
+
+    void set_deadline(std::chrono::steady_clock::time_point deadline) {
+        this->has_deadline_ = true;
+        this->deadline_ = deadline;
+    }
+
+    void clear_deadline() {
+        this->has_deadline_ = false;
+    }
+
+    // The pair solves of the last solve().
+    uint64_t step_count() const {
+        return this->steps_;
+    }
+
+    // A smaller budget of pair solves, for the callers that have other ways to go on.
+    void set_max_steps(uint64_t max_steps) {
+        this->max_steps_ = (std::max)(max_steps, uint64_t(1));
+    }
+
+    static bool is_supported(size_t goods_count) {
+        return (goods_count >= kMinGoods && goods_count <= kMaxGoods);
+    }
+
+    int solve(int64_t target, const std::vector<ExactItem> & exact_items,
+              std::vector<ExactChoice> & answer) {
+        answer.clear();
+        this->steps_ = 0;
+        this->status_ = ExactStatus::Infeasible;
+        if (!is_supported(exact_items.size()))
+            return ExactStatus::TooLarge;
+        if (target <= 0)
+            return ExactStatus::Infeasible;
+
+        int status = this->prepare_items(target, exact_items);
+        if (status != ExactStatus::Found)
+            return status;
+
+        ExactChoice choices[kMaxGoods];
+        bool found;
+        if (this->item_count_ == 2)
+            found = this->solve_two(target, this->items_[0], this->items_[1], choices[0], choices[1]);
+        else
+            found = this->solve_three(target, choices);
+        if (!found)
+            return this->status_;
+
+        answer.resize(this->item_count_);
+        for (size_t i = 0; i < this->item_count_; i++) {
+            answer[this->items_[i].index] = choices[i];
+        }
+        return ExactStatus::Found;
+    }
+
+private:
+    int prepare_items(int64_t target, const std::vector<ExactItem> & exact_items) {
+        size_t n = exact_items.size();
+        this->item_count_ = n;
+
+        int64_t min_total = 0, max_total = 0;
+        for (size_t i = 0; i < n; i++) {
+            const ExactItem & src = exact_items[i];
+            Item & item = this->items_[i];
+            item.index = i;
+            item.min_price = (std::max)(src.min_price, int64_t(1));
+            item.max_price = src.max_price;
+            item.min_count = (std::max)(src.min_count, int64_t(1));
+            item.max_count = src.max_count;
+            if (item.min_price > item.max_price)
+                return ExactStatus::Infeasible;
+            if (item.max_price >= kMaxPrice)
+                return ExactStatus::TooLarge;
+            item.center = (src.min_price + src.max_price) / 2;
+            item.center = (std::min)((std::max)(item.center, item.min_price), item.max_price);
+            min_total += item.min_count * item.min_price;
+        }
+        if (min_total > target)
+            return ExactStatus::Infeasible;
+
+        // Clip the counts by what is left of the target after the other goods take their minimum.
+        for (size_t i = 0; i < n; i++) {
+            Item & item = this->items_[i];
+            int64_t others = min_total - item.min_count * item.min_price;
+            int64_t max_count = (target - others) / item.min_price;
+            if (item.max_count <= 0 || item.max_count > max_count)
+                item.max_count = max_count;
+            if (item.min_count > item.max_count)
+                return ExactStatus::Infeasible;
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            max_total += this->items_[i].max_count * this->items_[i].max_price;
+        }
+        if (max_total < target)
+            return ExactStatus::Infeasible;
+
+        // The goods with the fewest counts is the one looped over, it goes last.
+        if (n == 3) {
+            size_t fewest = 0;
+            for (size_t i = 1; i < n; i++) {
+                if (this->items_[i].max_count - this->items_[i].min_count
+                    < this->items_[fewest].max_count - this->items_[fewest].min_count)
+                    fewest = i;
+            }
+            std::swap(this->items_[fewest], this->items_[n - 1]);
+        }
+        return ExactStatus::Found;
+    }
+
+    // Counts a pair solve, false if the search has to give up (status_ tells why).
+    bool count_step() {
+        this->steps_++;
+        if (this->steps_ >= this->max_steps_) {
+            this->status_ = ExactStatus::TooLarge;
+            return false;
+        }
+        if ((this->steps_ & 0xFFFF) == 0) {
+            if (this->has_deadline_ && std::chrono::steady_clock::now() >= this->deadline_) {
+                this->status_ = ExactStatus::Timeout;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool giving_up() const {
+        return (this->status_ != ExactStatus::Infeasible);
+    }
+
+    // c1 * p1 + c2 * p2 == target, with both counts in their ranges.
+    static bool solve_pair(int64_t target, const Item & item1, int64_t p1,
+                           const Item & item2, int64_t p2, ExactChoice & choice1, ExactChoice & choice2) {
+        int64_t x, y;
+        int64_t g = extended_gcd(p1, p2, x, y);
+        if (target % g != 0)
+            return false;
+
+        // c1 = c0 (mod m), and c2 = (target - c1 * p1) / p2 must be in [min_count, max_count].
+        int64_t m = p2 / g;
+        int64_t c0 = mod(mod(x, m) * mod(target / g, m), m);
+        int64_t low = (std::max)(item1.min_count, div_ceil(target - item2.max_count * p2, p1));
+        int64_t high = (std::min)(item1.max_count, div_floor(target - item2.min_count * p2, p1));
+        if (low > high)
+            return false;
+        int64_t c1 = low + mod(c0 - low, m);
+        if (c1 > high)
+            return false;
+
+        choice1 = ExactChoice(p1, c1);
+        choice2 = ExactChoice(p2, (target - c1 * p1) / p2);
+        assert(choice2.count >= item2.min_count && choice2.count <= item2.max_count);
+        return true;
+    }
+
+    // Can the goods with these count ranges reach target - [low, high] ?
+    static bool in_reach(int64_t target, int64_t low, int64_t high) {
+        return (target >= low && target <= high);
+    }
+
+    bool solve_two(int64_t target, const Item & item1, const Item & item2,
+                   ExactChoice & choice1, ExactChoice & choice2) {
+        int64_t terms1 = price_terms(item1), terms2 = price_terms(item2);
+        for (int64_t k1 = 0; k1 < terms1; k1++) {
+            int64_t p1 = nth_price(item1, k1);
+            if (!price_in_band(item1, p1))
+                continue;
+            if (!in_reach(target, item1.min_count * p1 + item2.min_count * item2.min_price,
+                          item1.max_count * p1 + item2.max_count * item2.max_price))
+                continue;
+            for (int64_t k2 = 0; k2 < terms2; k2++) {
+                int64_t p2 = nth_price(item2, k2);
+                if (!price_in_band(item2, p2))
+                    continue;
+                if (!this->count_step())
+                    return false;
+                if (solve_pair(target, item1, p1, item2, p2, choice1, choice2))
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    bool solve_three(int64_t target, ExactChoice * choices) {
+        const Item & item1 = this->items_[0];
+        const Item & item2 = this->items_[1];
+        const Item & item3 = this->items_[2];
+        int64_t terms1 = price_terms(item1), terms2 = price_terms(item2), terms3 = price_terms(item3);
+        int64_t low3 = item3.min_count * item3.min_price;
+        int64_t high3 = item3.max_count * item3.max_price;
+        for (int64_t k1 = 0; k1 < terms1; k1++) {
+            int64_t p1 = nth_price(item1, k1);
+            if (!price_in_band(item1, p1))
+                continue;
+            if (!in_reach(target, item1.min_count * p1 + item2.min_count * item2.min_price + low3,
+                          item1.max_count * p1 + item2.max_count * item2.max_price + high3))
+                continue;
+            for (int64_t k2 = 0; k2 < terms2; k2++) {
+                int64_t p2 = nth_price(item2, k2);
+                if (!price_in_band(item2, p2))
+                    continue;
+                // The two goods can only reach [low12, high12].
+                int64_t low12 = item1.min_count * p1 + item2.min_count * p2;
+                int64_t high12 = item1.max_count * p1 + item2.max_count * p2;
+                if (!in_reach(target, low12 + low3, high12 + high3))
+                    continue;
+                int64_t g12 = gcd(p1, p2);
+                for (int64_t k3 = 0; k3 < terms3; k3++) {
+                    int64_t p3 = nth_price(item3, k3);
+                    if (!price_in_band(item3, p3))
+                        continue;
+                    // target - c3 * p3 = 0 (mod g12): c3 = r (mod step).
+                    int64_t x, y;
+                    int64_t g = extended_gcd(mod(p3, g12) + g12, g12, x, y);
+                    int64_t rest = mod(target, g12);
+                    if (rest % g != 0)
+                        continue;
+                    int64_t step = g12 / g;
+                    int64_t r = (step == 1) ? 0 : mod(mod(x, step) * ((rest / g) % step), step);
+                    int64_t low = (std::max)(item3.min_count, div_ceil(target - high12, p3));
+                    int64_t high = (std::min)(item3.max_count, div_floor(target - low12, p3));
+                    for (int64_t c3 = low + mod(r - low, step); c3 <= high; c3 += step) {
+                        if (!this->count_step())
+                            return false;
+                        if (solve_pair(target - c3 * p3, item1, p1, item2, p2, choices[0], choices[1])) {
+                            choices[2] = ExactChoice(p3, c3);
+                            return true;
+                        }
+                    }
+                }
+                if (this->giving_up())
+                    return false;
+            }
+        }
+        return false;
+    }
+};
@@ -0,0 +1,315 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <chrono>
+
+#include "ExactSolver.h"
+#include "GcdSolver.h"
+
+//
+// The solver of the invoices with many goods (hundreds to thousands of lines), the same
+// problem as ExactSolver (ExactItem in, ExactChoice out, ExactStatus back). There the exact
+// solvers are too large, and a random restart rarely fits every count range at once.
+//
+//   1. the adjusters: the kAdjusters goods with the most counts and prices to choose from.
+//   2. the greedy fill: the other goods keep their input price, their counts are raised
+//      from the minimum in proportion to their count ranges, then one by one, until what
+//      is left of the total is about the nominal amount of the adjusters.
+//   3. the correction: the adjusters are solved exactly for the rest by GcdSolver, over
+//      their whole price bands and count ranges, with a small step budget.
+//
+// If the correction fails, one filled goods is moved by one count (the rest moves by its
+// price) and it's tried again, at most kMaxCorrections times or kMaxSteps pair solves of
+// GcdSolver in all. With fixed prices the adjusters reach few totals, so it may take many
+// cheap corrections, with price bands a correction rarely fails. It's not exhaustive: it
+// returns ExactStatus::TooLarge when it gives up, never ExactStatus::Infeasible.
+//
+// The goods are in structure-of-arrays vectors, so the O(n) fill passes read contiguous
+// int64 arrays only, and are kept between the solves.
+//
+class GreedyFillSolver
+{
+public:
+    static const size_t kMinGoods = 9;
+    static const size_t kAdjusters = GcdSolver::kMaxGoods;
+
+    static const size_t kMaxCorrections = 8192;
+    static const uint64_t kCorrectionSteps = uint64_t(1) << 16;
+    static const uint64_t kMaxSteps = uint64_t(1) << 22;
+
+    // The nominal count of an adjuster is at most this far above its minimum.
+    static const int64_t kNominalSpan = 32;
+
+private:
+    std::vector<int64_t>    prices_;
+    std::vector<int64_t>    min_prices_;
+    std::vector<int64_t>    max_prices_;
+    std::vector<int64_t>    min_counts_;
+    std::vector<int64_t>    max_counts_;    // clipped by the target if unlimited
+    std::vector<int64_t>    counts_;
+    std::vector<uint8_t>    is_adjuster_;
+
+    size_t                  adjusters_[kAdjusters];
+    std::vector<size_t>     order_;
+    std::vector<ExactItem>  adjuster_items_;
+    std::vector<ExactChoice> adjuster_answer_;
+    GcdSolver               gcd_solver_;
+    size_t                  corrections_;
+
+    bool                                    has_deadline_;
+    std::chrono::steady_clock::time_point   deadline_;
+
+public:
+    GreedyFillSolver() : corrections_(0), has_deadline_(false) {
+        this->gcd_solver_.set_max_steps(kCorrectionSteps);
+        for (size_t i = 0; i < kAdjusters; i++) {
+            this->adjusters_[i] = 0;
+        }
+    }
+
+    ~GreedyFillSolver() {
+    }
+
+    void set_deadline(std::chrono::steady_clock::time_point deadline) {
+        this->has_deadline_ = true;
+        this->deadline_ = deadline;
+        this->gcd_solver_.set_deadline(deadline);
+    }
+
+    void clear_deadline() {
+        this->has_deadline_ = false;
+        this->gcd_solver_.clear_deadline();
+    }
+
+    static bool is_supported(size_t goods_count) {
+        return (goods_count >= kMinGoods);
+    }
+
+    // The corrections tried by the last solve().
+    size_t correction_count() const {
+        return this->corrections_;
+    }
+
+    int solve(int64_t target, const std::vector<ExactItem> & items, std::vector<ExactChoice> & answer) {
+        answer.clear();
+        this->corrections_ = 0;
+        if (!is_supported(items.size()))
+            return ExactStatus::TooLarge;
+        if (target <= 0 || !this->load_items(target, items))
+            return ExactStatus::TooLarge;
+
+        this->choose_adjusters();
+        int64_t rest = this->fill(target);
+
+        size_t n = items.size();
+        size_t cursor = 0;
+        uint64_t steps = 0;
+        for (;;) {
+            int status = this->correct(rest);
+            if (status == ExactStatus::Found)
+                break;
+            if (status == ExactStatus::Timeout || this->is_deadline_passed())
+                return ExactStatus::Timeout;
+            steps += this->gcd_solver_.step_count();
+            if (this->corrections_ >= kMaxCorrections || steps >= kMaxSteps)
+                return ExactStatus::TooLarge;
+            this->corrections_++;
+            if (!this->shift_rest(rest, cursor))
+                return ExactStatus::TooLarge;
+        }
+
+        answer.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            answer[i] = ExactChoice(this->prices_[i], this->counts_[i]);
+        }
+        for (size_t j = 0; j < kAdjusters; j++) {
+            answer[this->adjusters_[j]] = this->adjuster_answer_[j];
+        }
+        return ExactStatus::Found;
+    }
+
+private:
+    bool is_deadline_passed() const {
+        return (this->has_deadline_ && std::chrono::steady_clock::now() >= this->deadline_);
+    }
+
+    bool load_items(int64_t target, const std::vector<ExactItem> & items) {
+        size_t n = items.size();
+        this->prices_.resize(n);
+        this->min_prices_.resize(n);
+        this->max_prices_.resize(n);
+        this->min_counts_.resize(n);
+        this->max_counts_.resize(n);
+        this->counts_.resize(n);
+        this->is_adjuster_.assign(n, 0);
+
+        for (size_t i = 0; i < n; i++) {
+            const ExactItem & item = items[i];
+            int64_t min_price = (std::max)(item.min_price, int64_t(1));
+            int64_t max_price = item.max_price;
+            if (max_price < min_price || max_price >= GcdSolver::kMaxPrice)
+                return false;
+            // The input price is the middle of the band.
+            int64_t price = (item.min_price + item.max_price) / 2;
+            int64_t min_count = (std::max)(item.min_count, int64_t(1));
+            int64_t max_count = target / min_price;
+            if (item.max_count >= min_count && item.max_count < max_count)
+                max_count = item.max_count;
+            if (min_count > max_count)
+                return false;
+            this->prices_[i] = (std::min)((std::max)(price, min_price), max_price);
+            this->min_prices_[i] = min_price;
+            this->max_prices_[i] = max_price;
+            this->min_counts_[i] = min_count;
+            this->max_counts_[i] = max_count;
+            this->counts_[i] = min_count;
+        }
+        return true;
+    }
+
+    // The goods with the most (count, price) choices, the widest count range first.
+    void choose_adjusters() {
+        size_t n = this->prices_.size();
+        this->order_.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            this->order_[i] = i;
+        }
+        const std::vector<int64_t> & min_counts = this->min_counts_;
+        const std::vector<int64_t> & max_counts = this->max_counts_;
+        const std::vector<int64_t> & min_prices = this->min_prices_;
+        const std::vector<int64_t> & max_prices = this->max_prices_;
+        std::partial_sort(this->order_.begin(), this->order_.begin() + kAdjusters, this->order_.end(),
+            [&](size_t lhs, size_t rhs) {
+                double lhs_choices = (double)(max_counts[lhs] - min_counts[lhs] + 1) * (double)(max_prices[lhs] - min_prices[lhs] + 1);
+                double rhs_choices = (double)(max_counts[rhs] - min_counts[rhs] + 1) * (double)(max_prices[rhs] - min_prices[rhs] + 1);
+                return (lhs_choices > rhs_choices || (lhs_choices == rhs_choices && lhs < rhs));
+            });
+        for (size_t j = 0; j < kAdjusters; j++) {
+            this->adjusters_[j] = this->order_[j];
+            this->is_adjuster_[this->order_[j]] = 1;
+        }
+    }
+
+    //
+    // Fills the other goods up to the target less the nominal amount of the adjusters,
+    // returns the rest of the target that the adjusters have to make.
+    //
+    int64_t fill(int64_t target) {
+        size_t n = this->prices_.size();
+        const int64_t * prices = this->prices_.data();
+        const int64_t * min_counts = this->min_counts_.data();
+        const int64_t * max_counts = this->max_counts_.data();
+        const uint8_t * is_adjuster = this->is_adjuster_.data();
+        int64_t * counts = this->counts_.data();
+
+        int64_t nominal = 0;
+        for (size_t j = 0; j < kAdjusters; j++) {
+            size_t idx = this->adjusters_[j];
+            int64_t span = (std::min)(max_counts[idx] - min_counts[idx], int64_t(kNominalSpan));
+            nominal += prices[idx] * (min_counts[idx] + span / 2);
+        }
+
+        int64_t filled = 0;
+        double capacity = 0.0;
+        for (size_t i = 0; i < n; i++) {
+            if (is_adjuster[i])
+                continue;
+            filled += prices[i] * min_counts[i];
+            capacity += (double)prices[i] * (double)(max_counts[i] - min_counts[i]);
+        }
+
+        int64_t room = target - nominal - filled;
+        if (room > 0 && capacity > 0.0) {
+            // The same fraction of every count range, rounded down so it never overshoots.
+            double fraction = (std::min)((double)room / capacity, 1.0);
+            for (size_t i = 0; i < n; i++) {
+                if (is_adjuster[i])
+                    continue;
+                int64_t extra = (int64_t)(fraction * (double)(max_counts[i] - min_counts[i]));
+                extra = (std::min)(extra, (std::max)(room, int64_t(0)) / prices[i]);
+                counts[i] = min_counts[i] + extra;
+                room -= prices[i] * extra;
+            }
+            // The rounding left less than a price of each goods.
+            for (size_t i = 0; i < n && room > 0; i++) {
+                if (is_adjuster[i])
+                    continue;
+                int64_t extra = (std::min)(max_counts[i] - counts[i], room / prices[i]);
+                counts[i] += extra;
+                room -= prices[i] * extra;
+            }
+        }
+
+        int64_t rest = target;
+        for (size_t i = 0; i < n; i++) {
+            if (!is_adjuster[i])
+                rest -= prices[i] * counts[i];
+        }
+        return rest;
+    }
+
+    int correct(int64_t rest) {
+        this->adjuster_items_.resize(kAdjusters);
+        for (size_t j = 0; j < kAdjusters; j++) {
+            size_t idx = this->adjusters_[j];
+            this->adjuster_items_[j] = ExactItem(this->min_prices_[idx], this->max_prices_[idx],
+                                                 this->min_counts_[idx], this->max_counts_[idx]);
+        }
+        return this->gcd_solver_.solve(rest, this->adjuster_items_, this->adjuster_answer_);
+    }
+
+    //
+    // Moves one filled goods by one count (or its price by one cent if no count can move),
+    // toward the reach of the adjusters if the rest is out of it, else up and down in turn.
+    // The goods are taken in turn from cursor.
+    //
+    bool shift_rest(int64_t & rest, size_t & cursor) {
+        int64_t low = 0, high = 0;
+        for (size_t j = 0; j < kAdjusters; j++) {
+            size_t idx = this->adjusters_[j];
+            low += this->min_counts_[idx] * this->min_prices_[idx];
+            high += this->max_counts_[idx] * this->max_prices_[idx];
+        }
+        if (rest < low)
+            return this->move_one(rest, cursor, false, false) || this->move_one(rest, cursor, false, true);
+        if (rest > high)
+            return this->move_one(rest, cursor, true, false) || this->move_one(rest, cursor, true, true);
+
+        bool raise = ((this->corrections_ & 1) != 0);
+        return (this->move_one(rest, cursor, raise, false) || this->move_one(rest, cursor, !raise, false)
+                || this->move_one(rest, cursor, raise, true) || this->move_one(rest, cursor, !raise, true));
+    }
+
+    // Raises (or lowers) the count or the price of the next goods that can move that way.
+    bool move_one(int64_t & rest, size_t & cursor, bool raise, bool move_price) {
+        size_t n = this->prices_.size();
+        for (size_t tries = 0; tries < n; tries++) {
+            size_t i = (cursor++) % n;
+            if (this->is_adjuster_[i])
+                continue;
+            if (move_price) {
+                if (raise ? (this->prices_[i] < this->max_prices_[i]) : (this->prices_[i] > this->min_prices_[i])) {
+                    this->prices_[i] += (raise ? 1 : -1);
+                    rest -= (raise ? this->counts_[i] : -this->counts_[i]);
+                    return true;
+                }
+            }
+            else {
+                if (raise ? (this->counts_[i] < this->max_counts_[i]) : (this->counts_[i] > this->min_counts_[i])) {
+                    this->counts_[i] += (raise ? 1 : -1);
+                    rest -= (raise ? this->prices_[i] : -this->prices_[i]);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+};
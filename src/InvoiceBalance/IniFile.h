@@ -5,43 +5,126 @@
 
 #include <cstdint>
 #include <cstddef>
-#include <iostream>
-#include <fstream>
 #include <string>
 #include <vector>
-#include <unordered_map>
 #include <cstring>
-#include <memory>
-#include <exception>
-#include <stdexcept>
+#include <algorithm>
 
+#include "MappedFile.h"
+
+//
+// A (pointer, size) view of chars owned by someone else, the std::string_view of C++11.
+//
+class StringRef
+{
+private:
+    const char *    data_;
+    size_t          size_;
+
+public:
+    StringRef() : data_(""), size_(0) {}
+    StringRef(const char * data, size_t size) : data_(data), size_(size) {}
+    StringRef(const char * str) : data_(str), size_(::strlen(str)) {}
+    StringRef(const std::string & str) : data_(str.data()), size_(str.size()) {}
+
+    const char * data() const { return this->data_; }
+    size_t size() const { return this->size_; }
+    bool empty() const { return (this->size_ == 0); }
+
+    char operator [] (size_t pos) const { return this->data_[pos]; }
+
+    std::string to_string() const {
+        return std::string(this->data_, this->size_);
+    }
+
+    int compare(const StringRef & other) const {
+        size_t len = (std::min)(this->size_, other.size_);
+        int result = (len != 0) ? ::memcmp(this->data_, other.data_, len) : 0;
+        if (result != 0)
+            return result;
+        return ((this->size_ < other.size_) ? -1 : ((this->size_ > other.size_) ? 1 : 0));
+    }
+
+    bool operator == (const StringRef & other) const {
+        return (this->size_ == other.size_ && ::memcmp(this->data_, other.data_, this->size_) == 0);
+    }
+    bool operator != (const StringRef & other) const {
+        return !(*this == other);
+    }
+    bool operator < (const StringRef & other) const {
+        return (this->compare(other) < 0);
+    }
+};
+
+//
+// The INI file of the settings: "[Section]" lines, "Key = Value" lines (the spaces around
+// the key and the value are trimmed) and comments starting with '#', '\'', ';' or '@'.
+//
+// The file is memory-mapped (or the text is given by set_text()) and parse() makes one
+// entry of StringRef per key, pointing into that text, so nothing is copied per line and
+// the lines have no length limit. The entries are indexed by key, a lookup is a binary
+// search. If a key is repeated, the last one wins. The views are valid until the next
+// open() or set_text().
+//
 class IniFile
 {
 public:
     typedef std::size_t         size_type;
 
+    struct Entry {
+        StringRef   section;
+        StringRef   key;
+        StringRef   value;
+    };
+
 private:
     std::string                 filename_;
-    std::vector<std::string>    lines_;
-    std::unordered_map<std::string, std::string> map_;
+    MappedFile                  file_;
+    std::string                 text_;
+    const char *                data_;
+    size_t                      size_;
 
-    static std::string          empty_string;
+    std::vector<Entry>          entries_;
+    std::vector<StringRef>      sections_;
+    // The indexes of entries_ sorted by key, the same keys in the order of the file.
+    std::vector<uint32_t>       key_index_;
+
+    IniFile(const IniFile &) = delete;
+    IniFile & operator = (const IniFile &) = delete;
 
 public:
-    IniFile() {
+    IniFile() : data_(nullptr), size_(0) {
     }
-    IniFile(const char * filename) : filename_(filename) {
+    IniFile(const char * filename) : filename_(filename), data_(nullptr), size_(0) {
         this->open(this->filename_.c_str());
     }
 
     virtual ~IniFile() {}
 
-    const std::vector<std::string> & get_lines() const {
-        return this->lines_;
+    const std::vector<Entry> & entries() const {
+        return this->entries_;
+    }
+
+    const std::vector<StringRef> & sections() const {
+        return this->sections_;
     }
 
     void clear() {
-        this->lines_.clear();
+        this->entries_.clear();
+        this->sections_.clear();
+        this->key_index_.clear();
+        this->file_.close();
+        this->text_.clear();
+        this->data_ = nullptr;
+        this->size_ = 0;
+    }
+
+    // Use the text read by the caller instead of a file, call parse() after it.
+    void set_text(std::string text) {
+        this->clear();
+        this->text_.swap(text);
+        this->data_ = this->text_.data();
+        this->size_ = this->text_.size();
     }
 
     static size_type skip_whitespace_chars(const std::string & str, size_type start = 0) {
@@ -99,113 +182,145 @@ public:
         return result;
     }
 
+    //
+    // Returns 0 if the file is mapped, -1 if there is no filename, -2 if the file can't be
+    // opened and -3 if it can't be mapped.
+    //
     int open() {
-        int err_code = 0;
-        if (this->filename_.empty() || this->filename_ == "") {
-            return -1;
-        }
-        const char * filename = this->filename_.c_str();
-        if (filename == nullptr) {
+        if (this->filename_.empty()) {
             return -1;
         }
         this->clear();
 
-        std::ifstream ifs;
-        try {
-            ifs.open(filename);
-            if (!ifs.fail()) {
-                while (!ifs.eof()) {
-                    static const size_t kLineBufSize = 256;
-                    char line[kLineBufSize];
-                    std::memset(line, 0, kLineBufSize);
-                    ifs.getline(line, kLineBufSize);
-                    std::string strLine = line;
-                    if (strLine.size() > 0) {
-                        this->lines_.push_back(std::move(strLine));
-                    }
-                }                
-            }
-            else {
-                std::ios::iostate rdstate = ifs.rdstate();
-                if ((rdstate & std::ifstream::failbit) != 0) {
-                    err_code = -2;
-                }
-                else if ((rdstate & std::ifstream::badbit) != 0) {
-                    err_code = -3;
-                }
-            }
-            ifs.close();
-        }
-        catch (std::exception & ex) {
-            std::cout << "Exception: " << ex.what() << std::endl << std::endl;
-            err_code = -4;
+        int err_code = this->file_.open(this->filename_.c_str());
+        if (err_code == 0) {
+            this->data_ = this->file_.data();
+            this->size_ = this->file_.size();
         }
         return err_code;
     }
 
+    // Returns the number of the sections and the keys.
     int parse() {
+        this->entries_.clear();
+        this->sections_.clear();
+        this->key_index_.clear();
+
+        const char * pos = this->data_;
+        const char * end = this->data_ + this->size_;
+        // The UTF-8 BOM
+        if (this->size_ >= 3 && ::memcmp(pos, "\xEF\xBB\xBF", 3) == 0)
+            pos += 3;
+
         int count = 0;
-        size_type line_size = this->lines_.size();
-        for (size_t i = 0; i < line_size; i++) {
-            const std::string & line = this->lines_[i];
-            std::string key, value;
-            size_type start, end;
-            size_type pos = skip_whitespace_chars(line, 0);
-            if (pos != std::string::npos) {
-                start = pos;
-                char ch = line[pos];
-                if (ch == '[') {
-                    // Section
-                    pos = find_char(line, pos + 1, ']');
-                    if (pos != std::string::npos) {
-                        end = pos;
-                        count++;
-                    }
-                }
-                else if (ch == '#' || ch == '\'' || ch == ';' || ch == '@') {
-                    // Comment, skip it.
+        StringRef section;
+        while (pos < end) {
+            const char * eol = (const char *)::memchr(pos, '\n', (size_t)(end - pos));
+            if (eol == nullptr)
+                eol = end;
+            StringRef line = trim(pos, eol);
+            pos = eol + 1;
+            if (line.empty())
+                continue;
+
+            char ch = line[0];
+            if (ch == '[') {
+                // Section
+                const char * close = (const char *)::memchr(line.data(), ']', line.size());
+                if (close != nullptr) {
+                    section = trim(line.data() + 1, close);
+                    this->sections_.push_back(section);
+                    count++;
                 }
-                else {
-                    // Other: Key-Value
-                    pos = find_char(line, pos, '=');
-                    if (pos != std::string::npos) {
-                        end = pos;
-                        if (start < end) {
-                            copy_string(line, key, start, end);
-                            pos++;
-                            copy_string(line, value, pos, line.size());
-                            if (!this->map_.count(key)) {
-                                this->map_.insert(std::make_pair(key, value));
-                            }
-                            else {
-                                this->map_[key] = value;
-                            }
-                            count++;
-                        }
+            }
+            else if (ch == '#' || ch == '\'' || ch == ';' || ch == '@') {
+                // Comment, skip it.
+            }
+            else {
+                // Other: Key-Value
+                const char * equal = (const char *)::memchr(line.data(), '=', line.size());
+                if (equal != nullptr) {
+                    Entry entry;
+                    entry.section = section;
+                    entry.key = trim(line.data(), equal);
+                    entry.value = trim(equal + 1, line.data() + line.size());
+                    if (!entry.key.empty()) {
+                        this->entries_.push_back(entry);
+                        count++;
                     }
                 }
             }
         }
+
+        this->key_index_.resize(this->entries_.size());
+        for (size_t i = 0; i < this->key_index_.size(); i++) {
+            this->key_index_[i] = (uint32_t)i;
+        }
+        const std::vector<Entry> & entries = this->entries_;
+        std::stable_sort(this->key_index_.begin(), this->key_index_.end(),
+            [&entries](uint32_t lhs, uint32_t rhs) {
+                return (entries[lhs].key < entries[rhs].key);
+            });
         return count;
     }
 
-    bool contains(const std::string & key) const {
-        return (this->map_.count(key) > 0);
+    // The last entry of key in any section, nullptr if there is none.
+    const Entry * find(const StringRef & key) const {
+        return this->find_entry(nullptr, key);
     }
 
-    const std::string & values(const std::string & key) const {
-        auto const & iter = this->map_.find(key);
-        if (iter != this->map_.end()) {
-            return iter->second;
-        }
-        else {
-            return IniFile::empty_string;
+    // The last entry of key in section, nullptr if there is none.
+    const Entry * find(const StringRef & section, const StringRef & key) const {
+        return this->find_entry(&section, key);
+    }
+
+    bool contains(const StringRef & key) const {
+        return (this->find(key) != nullptr);
+    }
+
+    bool contains(const StringRef & section, const StringRef & key) const {
+        return (this->find(section, key) != nullptr);
+    }
+
+    // The value of the last key in any section, empty if there is none.
+    StringRef values(const StringRef & key) const {
+        const Entry * entry = this->find(key);
+        return ((entry != nullptr) ? entry->value : StringRef());
+    }
+
+    StringRef values(const StringRef & section, const StringRef & key) const {
+        const Entry * entry = this->find(section, key);
+        return ((entry != nullptr) ? entry->value : StringRef());
+    }
+
+private:
+    static bool is_space(char ch) {
+        return (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\b' || ch == '\v');
+    }
+
+    static StringRef trim(const char * first, const char * last) {
+        while (first < last && is_space(*first))
+            first++;
+        while (last > first && is_space(*(last - 1)))
+            last--;
+        return StringRef(first, (size_t)(last - first));
+    }
+
+    const Entry * find_entry(const StringRef * section, const StringRef & key) const {
+        const std::vector<Entry> & entries = this->entries_;
+        std::vector<uint32_t>::const_iterator last =
+            std::upper_bound(this->key_index_.begin(), this->key_index_.end(), key,
+                [&entries](const StringRef & lhs, uint32_t rhs) {
+                    return (lhs < entries[rhs].key);
+                });
+        while (last != this->key_index_.begin()) {
+            --last;
+            const Entry & entry = entries[*last];
+            if (entry.key != key)
+                break;
+            if (section == nullptr || entry.section == *section)
+                return &entry;
         }
+        return nullptr;
     }
 };
-
-#if defined(_MSC_VER)
-__declspec(selectany) std::string IniFile::empty_string;
-#else
-std::string IniFile::empty_string;
-#endif
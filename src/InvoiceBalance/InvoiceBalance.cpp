@@ -10,35 +10,44 @@
 #include <math.h>
 #include <time.h>
 #include <assert.h>
+#include <ctype.h>
+#include <string.h>
 
 #include <limits>
 #include <cmath>
 #include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <deque>
+#include <list>
+#include <condition_variable>
+#include <memory>
+#include <iostream>
+#include <fstream>
+#include <stdexcept>
+
+#if !defined(_WIN32)
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
 
 #include "CountOf.h"
 #include "IniFile.h"
-
-struct CountRange {
-    int min;
-    int max;
-
-    CountRange() : min(0), max(0) {}
-    CountRange(int min, int max) : min(min), max(max) {}
-    CountRange(const CountRange & src) : min(src.min), max(src.max) {}
-
-    CountRange & operator = (const CountRange & rhs) {
-        if (&rhs != this) {
-            this->min = rhs.min;
-            this->max = rhs.max;
-        }
-        return *this;
-    }
-};
+#include "InvoiceBalance.h"
+#include "InvoiceBalanceApi.h"
+#include "InvoiceSplitter.h"
 
 static const double kDefaultTotalPrice = 120000.0;
 static const double kDefaultFluctuation = 2.0;
 
-static const size_t kMaxGoodsCount = 20;
+// The goods of one --daemon request, the config files have no limit.
+static const size_t kMaxRequestGoods = 100000;
 
 static double default_goods_prices[] = {
     212.00,
@@ -52,909 +61,1398 @@ static CountRange default_goods_count_range[] = {
     { 100, 0 }
 };
 
-struct RoundingType {
-    enum {
-        RoundDown,
-        RoundUp,
-        HalfAdjust
-    };
-};
-
-uint32_t next_random32()
-{
-#if (RAND_MAX == 0x7FFF)
-    return (((rand() & 0x7FFF) << 30) | ((rand() & 0x7FFF) << 15) | (rand() & 0x7FFF));
-#else
-    return rand();
-#endif
-}
-
-uint64_t next_random64()
+Money strToMoney(const std::string & value, Money default_value)
 {
-    return (((uint64_t)next_random32() << 32) | (uint64_t)next_random32());
+    Money money;
+    if (Money::parse(value, money))
+        return money;
+    else
+        return default_value;
 }
 
-//
-// See: https://www.zhihu.com/question/29971598
-//
-double next_random_box_muller(double mu, double sigma)
+bool parse_count_range(const std::string & value, int & min_val, int & max_val)
 {
-    const double epsilon = std::numeric_limits<double>::min();
-    const double two_pi = 2.0 * 3.14159265358979323846;
-
-    static double z0, z1;
-    static bool generate;
-    generate = !generate;
-
-    if (!generate) {
-        return (z1 * sigma + mu);
+    bool is_ok = false;
+    size_t pos, start;
+    int min_value, max_value;
+    try {
+        start = IniFile::skip_whitespace_chars(value);
+        if (start != std::string::npos) {
+            pos = IniFile::find_char(value, start, '-');
+            if (pos != std::string::npos) {
+                std::string str_min, str_max;
+                // range: min value
+                IniFile::copy_string(value, str_min, start, pos);
+                if (str_min.size() > 0 && !str_min.empty()) {
+                    min_value = std::atoi(str_min.c_str());
+                    if (min_value > 0) {
+                        min_val = min_value;
+                        is_ok = true;
+                    }
+                }
+                // range: max value
+                IniFile::copy_string(value, str_max, pos + 1, value.size());
+                if (str_max.size() > 0 && !str_max.empty()) {
+                    max_value = std::stoi(str_max.c_str());
+                    if (max_value > 0) {
+                        max_val = max_value;
+                    }
+                }
+            }
+            else {
+                // range: min value
+                min_value = std::stoi(value.c_str() + start);
+                if (min_value > 0) {
+                    min_val = min_value;
+                    is_ok = true;
+                }
+            }
+        }
+    } catch (const std::invalid_argument & ex) {
+        std::cout << "std::invalid_argument::what(): " << ex.what() << '\n';
+    } catch (const std::out_of_range & ex) {
+        std::cout << "std::out_of_range::what(): " << ex.what() << '\n';
     }
-
-    double u1, u2;
-    do {
-        u1 = rand() * (1.0 / RAND_MAX);
-        u2 = rand() * (1.0 / RAND_MAX);
-    } while (u1 <= epsilon);
-
-    z0 = sqrt(-2.0 * log(u1)) * cos(two_pi * u2);
-    z1 = sqrt(-2.0 * log(u1)) * sin(two_pi * u2);
-    return (z0 * sigma + mu);
-}
-
-int32_t next_random_i32(int32_t min_num, int32_t max_num)
-{
-    if (min_num < max_num)
-        return (min_num + (next_random32() % uint32_t(max_num - min_num + 1)));
-    else if (min_num > max_num)
-        return (max_num + (next_random32() % uint32_t(min_num - max_num + 1)));
-    else
-        return min_num;
+    return is_ok;
 }
 
-int64_t next_random_i64(int64_t min_num, int64_t max_num)
+int parse_solver_mode(const std::string & value, int default_mode)
 {
-    if (min_num < max_num)
-        return (min_num + (next_random64() % int64_t(max_num - min_num + 1)));
-    else if (min_num > max_num)
-        return (max_num + (next_random64() % int64_t(min_num - max_num + 1)));
-    else
-        return min_num;
-}
+    size_t start = IniFile::skip_whitespace_chars(value);
+    if (start == std::string::npos)
+        return default_mode;
+
+    std::string mode;
+    size_t pos = start;
+    while (pos < value.size() && value[pos] != ' ' && value[pos] != '\t') {
+        mode.push_back((char)::tolower(value[pos]));
+        pos++;
+    }
 
-size_t next_random_64(size_t min_num, size_t max_num)
-{
-    if (min_num < max_num)
-        return (min_num + (next_random64() % size_t(max_num - min_num + 1)));
-    else if (min_num > max_num)
-        return (max_num + (next_random64() % size_t(min_num - max_num + 1)));
+    if (mode == "random")
+        return SolverMode::Random;
+    else if (mode == "fast")
+        return SolverMode::Fast;
+    else if (mode == "exact")
+        return SolverMode::Exact;
+    else if (mode == "parallel")
+        return SolverMode::Parallel;
+    else if (mode == "mitm")
+        return SolverMode::MeetInMiddle;
+    else if (mode == "bnb")
+        return SolverMode::BranchBound;
+    else if (mode == "portfolio")
+        return SolverMode::Portfolio;
     else
-        return min_num;
+        return default_mode;
 }
 
-double normal_dist_next_random()
+// The ## of a "Price##" key, without leading zeros.
+bool parse_key_index(const StringRef & key, const char * prefix, size_t & index)
 {
-    const double l_limit = -3.0, r_limit = 3.0;
-    double randomf = next_random_box_muller(0.0, 1.0);
-    if (randomf > r_limit)
-        randomf = r_limit;
-    else if (randomf < l_limit)
-        randomf = l_limit;
-
-    // normalize to [-1, 1]
-    randomf /= r_limit;
-
-    // translation to [0, 1]
-    randomf = (randomf + 1.0) / 2.0;
-    return randomf;
-}
-
-int32_t normal_dist_random_i32(int32_t min_num, int32_t max_num)
-{
-    double randomf = normal_dist_next_random();
-    assert(randomf >= 0.0 && randomf <= 1.0);
-
-    if (min_num < max_num)
-        return (min_num + int32_t(randomf * (max_num - min_num)));
-    else if (min_num > max_num)
-        return (max_num + int32_t(randomf * (min_num - max_num)));
-    else
-        return min_num;
+    size_t prefix_len = strlen(prefix);
+    if (key.size() <= prefix_len || key.size() > prefix_len + 9 || memcmp(key.data(), prefix, prefix_len) != 0)
+        return false;
+    if (key[prefix_len] == '0')
+        return false;
+    index = 0;
+    for (size_t pos = prefix_len; pos < key.size(); pos++) {
+        char ch = key[pos];
+        if (ch < '0' || ch > '9')
+            return false;
+        index = index * 10 + (size_t)(ch - '0');
+    }
+    return true;
 }
 
-int64_t normal_dist_random_i64(int64_t min_num, int64_t max_num)
-{
-    double randomf = normal_dist_next_random();
+struct AppConfig {
+    Money  total_amount;
+    Money  fluctuation;
+    int    solver_mode;
+    size_t thread_count;
+    uint64_t random_seed;
+    std::string cache_file;
+    bool   print_stats;
+    int64_t time_limit_ms;
+    Money  target_error;
+    Money  max_invoice_amount;
 
-    if (min_num < max_num)
-        return (min_num + int64_t(randomf * (max_num - min_num)));
-    else if (min_num > max_num)
-        return (max_num + int64_t(randomf * (min_num - max_num)));
-    else
-        return min_num;
-}
+    std::vector<Goods> goods;
+};
 
-size_t normal_dist_random_64(size_t min_num, size_t max_num)
+size_t read_config_value(IniFile & iniFile, AppConfig & config)
 {
-    double randomf = normal_dist_next_random();
+    std::string value;
 
-    if (min_num < max_num)
-        return (min_num + size_t(randomf * (max_num - min_num)));
-    else if (min_num > max_num)
-        return (max_num + size_t(randomf * (min_num - max_num)));
-    else
-        return min_num;
-}
+    // TotalPrice
+    if (iniFile.contains("TotalAmount")) {
+        value = iniFile.values("TotalAmount").to_string();
+        config.total_amount = strToMoney(value, Money::from_yuan(kDefaultTotalPrice));
+    }
+    else {
+        config.total_amount = Money::from_yuan(kDefaultTotalPrice);
+    }
 
-double normal_dist_random_f(double minimun, double maximum)
-{
-    double randomf = normal_dist_next_random();
+    // Fluctuation
+    if (iniFile.contains("Fluctuation")) {
+        value = iniFile.values("Fluctuation").to_string();
+        config.fluctuation = strToMoney(value, Money::from_yuan(kDefaultFluctuation));
+    }
+    else {
+        config.fluctuation = Money::from_yuan(kDefaultFluctuation);
+    }
 
-    if (minimun < maximum)
-        return (minimun + randomf * (maximum - minimun));
-    else if (minimun > maximum)
-        return (maximum + randomf * (minimun - maximum));
-    else
-        return minimun;
-}
+    // Solver
+    if (iniFile.contains("Solver")) {
+        value = iniFile.values("Solver").to_string();
+        config.solver_mode = parse_solver_mode(value, SolverMode::Random);
+    }
+    else {
+        config.solver_mode = SolverMode::Random;
+    }
 
-double round_currency(double price, double precision = 100.0, int round_type = RoundingType::HalfAdjust)
-{
-    if (round_type == RoundingType::RoundDown)
-        return floor(price * precision) / precision;
-    else if (round_type == RoundingType::RoundUp)
-        return ceil(price * precision) / precision;
-    else
-        return floor(price * precision + 0.5) / precision;
-}
+    // Threads, 0 is all the cores
+    if (iniFile.contains("Threads")) {
+        value = iniFile.values("Threads").to_string();
+        int threads = std::atoi(value.c_str());
+        config.thread_count = (threads > 0) ? (size_t)threads : 0;
+    }
+    else {
+        config.thread_count = 0;
+    }
 
-struct GoodsInvoice
-{
-    bool            auto_release;
-    size_t          count;
-    double *        prices;
-    size_t *        counts;
-    CountRange *    count_ranges;
+    // Seed, 0 or empty is a new seed every run
+    if (iniFile.contains("Seed")) {
+        value = iniFile.values("Seed").to_string();
+        config.random_seed = (uint64_t)std::strtoull(value.c_str(), nullptr, 10);
+    }
+    else {
+        config.random_seed = 0;
+    }
 
-    GoodsInvoice() : auto_release(false), count(0),
-                     prices(nullptr), counts(nullptr), count_ranges(nullptr) {
+    // Cache, the file of the solution cache, empty is no cache
+    if (iniFile.contains("Cache")) {
+        value = iniFile.values("Cache").to_string();
+        size_t start = IniFile::skip_whitespace_chars(value);
+        size_t end = value.find_last_not_of(" \t\r");
+        config.cache_file = (start != std::string::npos) ? value.substr(start, end + 1 - start) : "";
+    }
+    else {
+        config.cache_file.clear();
     }
 
-    GoodsInvoice(size_t goods_count, double goods_prices[],
-                 CountRange goods_count_ranges[] = nullptr,
-                 size_t goods_counts[] = nullptr)
-        : auto_release(false), count(goods_count),
-          prices(goods_prices), counts(goods_counts), count_ranges(goods_count_ranges) {
+    // Stats, 1 prints the search counters as JSON
+    if (iniFile.contains("Stats")) {
+        value = iniFile.values("Stats").to_string();
+        config.print_stats = (std::atoi(value.c_str()) != 0);
+    }
+    else {
+        config.print_stats = false;
     }
 
-    GoodsInvoice(const GoodsInvoice & other)
-        : auto_release(false), count(0),
-          prices(nullptr), counts(nullptr), count_ranges(nullptr) {
-        this->construct_copy(other);
+    // TimeLimit, the time budget of the search in ms, 0 is 1000000 restarts at most
+    if (iniFile.contains("TimeLimit")) {
+        value = iniFile.values("TimeLimit").to_string();
+        config.time_limit_ms = (int64_t)std::strtoll(value.c_str(), nullptr, 10);
+    }
+    else {
+        config.time_limit_ms = 0;
     }
 
-    ~GoodsInvoice() {
-        this->destroy();
+    // TargetError, the search stops when the error is not larger
+    if (iniFile.contains("TargetError")) {
+        value = iniFile.values("TargetError").to_string();
+        config.target_error = strToMoney(value, Money(0));
+    }
+    else {
+        config.target_error = Money(0);
     }
 
-    size_t size() const {
-        return this->count;
+    // MaxInvoiceAmount, a larger total is split into several invoices, 0 is no limit
+    if (iniFile.contains("MaxInvoiceAmount")) {
+        value = iniFile.values("MaxInvoiceAmount").to_string();
+        config.max_invoice_amount = strToMoney(value, Money(0));
+    }
+    else {
+        config.max_invoice_amount = Money(0);
     }
 
-    double moneys(size_t index) const {
-        assert(index < this->count);
-        return round_currency(this->prices[index] * this->counts[index]);
+    // Price list: all the Price## keys in the order of ##, any number of them.
+    std::vector<std::pair<size_t, const IniFile::Entry *>> price_entries;
+    const std::vector<IniFile::Entry> & entries = iniFile.entries();
+    for (size_t i = 0; i < entries.size(); i++) {
+        size_t index;
+        if (parse_key_index(entries[i].key, "Price", index))
+            price_entries.push_back(std::make_pair(index, &entries[i]));
     }
+    // The same ## again: the last one wins.
+    std::stable_sort(price_entries.begin(), price_entries.end(),
+        [](const std::pair<size_t, const IniFile::Entry *> & lhs,
+           const std::pair<size_t, const IniFile::Entry *> & rhs) {
+            return (lhs.first < rhs.first);
+        });
 
-    void destroy() {
-        if (this->auto_release) {
-            if (this->prices) {
-                delete[] this->prices;
-                this->prices = nullptr;
-            }
-            if (this->counts) {
-                delete[] this->counts;
-                this->counts = nullptr;
-            }
-            if (this->count_ranges) {
-                delete[] this->count_ranges;
-                this->count_ranges = nullptr;
+    size_t goods_count = 0;
+    char range_name[32];
+    for (size_t i = 0; i < price_entries.size(); i++) {
+        if (i + 1 < price_entries.size() && price_entries[i + 1].first == price_entries[i].first)
+            continue;
+        size_t index = price_entries[i].first;
+
+        // Price ##
+        value = price_entries[i].second->value.to_string();
+        Money goods_price = strToMoney(value, Money(0));
+        if (!goods_price.is_zero()) {
+            Goods goods;
+            goods.price = goods_price;
+            // Range ##
+            int range_min = 1, range_max = 0;
+            snprintf(range_name, sizeof(range_name), "Range%llu", (unsigned long long)index);
+            if (iniFile.contains(range_name)) {
+                value = iniFile.values(range_name).to_string();
+                bool is_ok = parse_count_range(value, range_min, range_max);
+                if (is_ok) {
+                    // Read OK
+                }
             }
+            goods.count_range.min = range_min;
+            goods.count_range.max = range_max;
+            config.goods.push_back(goods);
+            goods_count++;
         }
     }
 
-    GoodsInvoice & operator = (const GoodsInvoice & rhs) {
-        this->copy(rhs);
-        return *this;
+    return goods_count;
+}
+
+// The searches need positive prices, the daemon and the C interface reject the others too.
+bool has_positive_prices(const std::vector<Goods> & goods_list)
+{
+    for (size_t i = 0; i < goods_list.size(); i++) {
+        if (goods_list[i].price <= Money(0))
+            return false;
     }
+    return true;
+}
 
-    void attach(const GoodsInvoice & other) {
-        if (&other != this) {
-            this->destroy();
+//
+// Batch mode: the input has many invoice jobs, each job starts with a "[Invoice]" line and
+// has its own TotalAmount, Fluctuation, Price## and Range## lines. The lines before the first
+// "[Invoice]" are the defaults of all the jobs (Solver, Fluctuation, and so on).
+//
+// The jobs are solved by a pool of workers, one job per worker at a time, and the results are
+// written in the input order as soon as all the jobs before them are done. The reader is at
+// most kJobsPerWorker * threads jobs ahead of the writer, so the memory is bounded.
+//
+class InvoiceBatch
+{
+public:
+    static const size_t kJobsPerWorker = 16;
+
+private:
+    struct Job {
+        size_t                      index;
+        std::string                 text;
+        std::string                 result;
+        bool                        found;
+        bool                        done;
+
+        Job() : index(0), found(false), done(false) {}
+    };
+
+    size_t                      thread_count_;
+    uint64_t                    random_seed_;
+    std::string                 default_text_;
+    SolutionCache *             solution_cache_;
+
+    // Job i is in slots_[i % slots_.size()] from it's read until it's written.
+    std::vector<Job>            slots_;
+    std::deque<size_t>          pending_;
+    size_t                      read_count_;
+    size_t                      written_count_;
+    size_t                      found_count_;
+    bool                        eof_;
 
-            this->auto_release  = false;
-            this->count         = other.size();
-            this->prices        = other.prices;
-            this->counts       = other.counts;
-            this->count_ranges = other.count_ranges;
+    std::mutex                  mutex_;
+    std::condition_variable     job_ready_;
+    std::condition_variable     job_done_;
+    std::condition_variable     slot_free_;
+
+public:
+    InvoiceBatch(size_t thread_count, uint64_t random_seed, SolutionCache * solution_cache = nullptr)
+        : thread_count_(thread_count), random_seed_(random_seed), solution_cache_(solution_cache),
+          read_count_(0), written_count_(0), found_count_(0), eof_(false) {
+        if (this->thread_count_ == 0) {
+            this->thread_count_ = (std::max)((size_t)std::thread::hardware_concurrency(), size_t(1));
         }
+        this->slots_.resize(this->thread_count_ * kJobsPerWorker);
     }
 
-    bool create_new_invoice(const GoodsInvoice & other) {
-        assert(other.size() != 0);
-        size_t goods_count = other.size();
-        this->auto_release = true;
-        this->count = goods_count;
+    size_t job_count() const { return this->written_count_; }
+    size_t found_count() const { return this->found_count_; }
 
-        // price
-        double * new_goods_prices = new double[goods_count];
-        if (new_goods_prices == nullptr) {
-            return false;
-        }
+    static bool is_invoice_line(const std::string & line) {
+        size_t pos = IniFile::skip_whitespace_chars(line);
+        return (pos != std::string::npos && line.compare(pos, 9, "[Invoice]") == 0);
+    }
 
-        if (other.prices != nullptr) {
-            for (size_t i = 0; i < goods_count; i++) {
-                new_goods_prices[i] = other.prices[i];
-            }
-        }
-        else {
-            for (size_t i = 0; i < goods_count; i++) {
-                new_goods_prices[i] = 0.0;
-            }
+    //
+    // Reads the jobs from is and writes the results to out, returns 0 if all the jobs
+    // have found a perfect answer.
+    //
+    int run(std::istream & is, FILE * out) {
+        std::vector<std::thread> workers;
+        workers.reserve(this->thread_count_);
+        for (size_t i = 0; i < this->thread_count_; i++) {
+            workers.push_back(std::thread([this]() { this->worker(); }));
         }
-        this->prices = new_goods_prices;
+        std::thread writer([this, out]() { this->writer(out); });
 
-        // count
-        size_t * new_goods_counts = new size_t[goods_count];
-        if (new_goods_counts == nullptr) {
-            return false;
+        this->read_jobs(is);
+
+        for (size_t i = 0; i < workers.size(); i++) {
+            workers[i].join();
         }
+        writer.join();
+        return ((this->found_count_ == this->written_count_) ? 0 : 1);
+    }
 
-        if (other.counts == nullptr) {
-            for (size_t i = 0; i < goods_count; i++) {
-                new_goods_counts[i] = 0;
+private:
+    void read_jobs(std::istream & is) {
+        std::string text;
+        bool in_job = false;
+        std::string line;
+        while (std::getline(is, line)) {
+            if (!line.empty() && line[line.size() - 1] == '\r')
+                line.resize(line.size() - 1);
+            if (is_invoice_line(line)) {
+                if (in_job)
+                    this->push_job(text);
+                else
+                    this->default_text_.swap(text);
+                text.clear();
+                in_job = true;
             }
-        }
-        else {
-            for (size_t i = 0; i < goods_count; i++) {
-                new_goods_counts[i] = other.counts[i];
+            else if (!line.empty()) {
+                text += line;
+                text += '\n';
             }
         }
-        this->counts = new_goods_counts;
+        if (in_job)
+            this->push_job(text);
 
-        // count range
-        CountRange * new_goods_count_ranges = new CountRange[goods_count];
-        if (new_goods_count_ranges == nullptr) {
-            return false;
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        this->eof_ = true;
+        this->job_ready_.notify_all();
+        this->job_done_.notify_all();
+    }
+
+    void push_job(std::string & text) {
+        std::unique_lock<std::mutex> lock(this->mutex_);
+        while (this->read_count_ - this->written_count_ >= this->slots_.size()) {
+            this->slot_free_.wait(lock);
         }
+        size_t index = this->read_count_++;
+        Job & job = this->slots_[index % this->slots_.size()];
+        job.index = index;
+        job.text.swap(text);
+        job.result.clear();
+        job.found = false;
+        job.done = false;
+        this->pending_.push_back(index);
+        this->job_ready_.notify_one();
+    }
 
-        if (other.count_ranges == nullptr) {
-            for (size_t i = 0; i < goods_count; i++) {
-                new_goods_count_ranges[i].min = 1;
-                new_goods_count_ranges[i].max = 0;
+    void worker() {
+        std::string text;
+        std::string result;
+        for (;;) {
+            size_t index;
+            {
+                std::unique_lock<std::mutex> lock(this->mutex_);
+                while (this->pending_.empty() && !this->eof_) {
+                    this->job_ready_.wait(lock);
+                }
+                if (this->pending_.empty())
+                    break;
+                index = this->pending_.front();
+                this->pending_.pop_front();
+                // The slot is only reused after it's written, it's safe to read it unlocked.
+                text.swap(this->slots_[index % this->slots_.size()].text);
             }
+
+            bool found = this->solve_job(index, text, result);
+
+            std::lock_guard<std::mutex> lock(this->mutex_);
+            Job & job = this->slots_[index % this->slots_.size()];
+            job.result.swap(result);
+            job.found = found;
+            job.done = true;
+            this->job_done_.notify_all();
         }
-        else {
-            for (size_t i = 0; i < goods_count; i++) {
-                new_goods_count_ranges[i] = other.count_ranges[i];
+    }
+
+    void writer(FILE * out) {
+        std::string result;
+        for (;;) {
+            bool found;
+            {
+                std::unique_lock<std::mutex> lock(this->mutex_);
+                for (;;) {
+                    if (this->written_count_ < this->read_count_) {
+                        if (this->slots_[this->written_count_ % this->slots_.size()].done)
+                            break;
+                    }
+                    else if (this->eof_) {
+                        return;
+                    }
+                    this->job_done_.wait(lock);
+                }
+                Job & job = this->slots_[this->written_count_ % this->slots_.size()];
+                result.swap(job.result);
+                found = job.found;
             }
-        }
-        this->count_ranges = new_goods_count_ranges;
 
-        return true;
-    }
+            fwrite(result.data(), 1, result.size(), out);
+            fflush(out);
 
-    bool copy_invoice(const GoodsInvoice & other) {
-        assert(other.size() != 0);
-        assert(this->count == other.size());
-        size_t goods_count = other.size();
-        assert(this->auto_release);
-        this->auto_release = true;
-        this->count = goods_count;
+            std::lock_guard<std::mutex> lock(this->mutex_);
+            if (found)
+                this->found_count_++;
+            this->written_count_++;
+            this->slot_free_.notify_one();
+        }
+    }
 
-        // price
-        if (other.prices != nullptr) {
-            for (size_t i = 0; i < goods_count; i++) {
-                this->prices[i] = other.prices[i];
-            }
+    bool solve_job(size_t index, const std::string & text, std::string & result) {
+        // The keys of the job come after the defaults, so they win.
+        std::string all_text;
+        all_text.reserve(this->default_text_.size() + text.size());
+        all_text += this->default_text_;
+        all_text += text;
+
+        IniFile iniFile;
+        iniFile.set_text(std::move(all_text));
+        iniFile.parse();
+
+        AppConfig config;
+        size_t goods_count = read_config_value(iniFile, config);
+
+        char buf[128];
+        result = "[Invoice]\n";
+        snprintf(buf, sizeof(buf), "Index=%u\n", (uint32_t)(index + 1));
+        result += buf;
+        if (goods_count == 0) {
+            result += "Status=invalid\nReason=no_goods\n\n";
+            return false;
         }
-        else {
-            for (size_t i = 0; i < goods_count; i++) {
-                this->prices[i] = 0.0;
-            }
+        if (!has_positive_prices(config.goods)) {
+            result += "Status=invalid\nReason=bad_price\n\n";
+            return false;
         }
 
-        // count
-        if (other.counts == nullptr) {
-            for (size_t i = 0; i < goods_count; i++) {
-                this->counts[i] = 0;
-            }
+        InvoiceBalance balance(config.total_amount, config.fluctuation);
+        balance.set_verbose(false);
+        balance.set_solution_cache(this->solution_cache_);
+        balance.set_collect_timing(config.print_stats);
+        balance.set_time_limit(config.time_limit_ms);
+        balance.set_target_error(config.target_error);
+        balance.set_price_and_count(config.goods);
+        // The same batch seed replays the same results, whatever the number of workers is.
+        balance.set_random_seed((config.random_seed != 0) ? config.random_seed : (this->random_seed_ + index));
+
+        // The pool already uses all the cores, a parallel (or portfolio) job is searched by its
+        // worker only, a portfolio would start its own threads in every worker.
+        int solver_mode = config.solver_mode;
+        if (solver_mode == SolverMode::Parallel || solver_mode == SolverMode::Portfolio)
+            solver_mode = SolverMode::Random;
+        bool found = balance.search(solver_mode);
+
+        if (found) {
+            result += "Status=found\n";
+        }
+        else if (balance.is_proved_infeasible()) {
+            const PresolveResult & presolve = balance.get_presolve_result();
+            result += "Status=infeasible\n";
+            result += std::string("Reason=") + presolve.reason_name() + "\n";
+            result += "NearestTotal=" + Money(presolve.nearest_total).to_string() + "\n";
         }
         else {
-            for (size_t i = 0; i < goods_count; i++) {
-                this->counts[i] = other.counts[i];
-            }
+            result += "Status=not_found\n";
         }
-
-        // count range
-        if (other.count_ranges == nullptr) {
-            for (size_t i = 0; i < goods_count; i++) {
-                this->count_ranges[i].min = 1;
-                this->count_ranges[i].max = 0;
+        result += "TotalAmount=" + config.total_amount.to_string() + "\n";
+        if (balance.has_best_answer()) {
+            result += "PriceError=" + balance.get_price_error().to_string() + "\n";
+            const InvoiceBalance::GoodsList & answer = balance.get_best_answer();
+            for (size_t i = 0; i < answer.size(); i++) {
+                snprintf(buf, sizeof(buf), "Count%u=%u\nPrice%u=%s\n",
+                         (uint32_t)(i + 1), (uint32_t)answer[i].count,
+                         (uint32_t)(i + 1), answer[i].price.to_string().c_str());
+                result += buf;
             }
         }
-        else {
-            for (size_t i = 0; i < goods_count; i++) {
-                this->count_ranges[i] = other.count_ranges[i];
-            }
+        if (config.print_stats) {
+            result += "Stats=" + balance.get_search_stats().to_json() + "\n";
         }
-
-        return true;
+        result += "\n";
+        return found;
     }
+};
 
-    void construct_copy(const GoodsInvoice & other) {
-        if (other.size() != 0) {
-            this->create_new_invoice(other);
-        }
+//
+// InvoiceBalance --batch <file | ->  [--threads N] [--seed N] [--cache FILE]
+//
+int run_batch(int argc, char * argv[])
+{
+    const char * filename = nullptr;
+    const char * cache_file = nullptr;
+    size_t thread_count = 0;
+    uint64_t random_seed = 0;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--batch" && i + 1 < argc)
+            filename = argv[++i];
+        else if (arg == "--cache" && i + 1 < argc)
+            cache_file = argv[++i];
+        else if (arg == "--threads" && i + 1 < argc)
+            thread_count = (size_t)std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--seed" && i + 1 < argc)
+            random_seed = (uint64_t)std::strtoull(argv[++i], nullptr, 10);
+    }
+    if (filename == nullptr) {
+        fprintf(stderr, " Usage: InvoiceBalance --batch <file | -> [--threads N] [--seed N] [--cache FILE]\n");
+        return -1;
     }
 
-    bool internal_copy(const GoodsInvoice & other) {
-        bool success;
-        if (other.size() != 0) {
-            if (other.size() != this->count || !this->auto_release) {
-                this->destroy();
-                success = this->create_new_invoice(other);
-            }
-            else {
-                success = this->copy_invoice(other);
-            }
-        }
-        else {
-            this->destroy();
-            success = true;
-        }
-        return success;
+    if (random_seed == 0) {
+        random_seed = (uint64_t)std::chrono::high_resolution_clock::now().time_since_epoch().count();
     }
 
-    bool copy(const GoodsInvoice & other) {
-        if (&other != this) {
-            return this->internal_copy(other);
+    std::ifstream ifs;
+    bool use_stdin = (std::string(filename) == "-");
+    if (!use_stdin) {
+        ifs.open(filename);
+        if (ifs.fail()) {
+            fprintf(stderr, " Can't open the batch file: %s\n", filename);
+            return -1;
         }
+    }
 
-        return false;
+    SolutionCache solution_cache;
+    if (cache_file != nullptr && !solution_cache.open(cache_file)) {
+        fprintf(stderr, " Can't open the cache file: %s\n", cache_file);
+        return -1;
     }
 
-    bool clone(const GoodsInvoice & other) {
-        if (&other != this) {
-            if (other.auto_release) {
-                assert(other.auto_release);
-                return this->internal_copy(other);
-            }
-            else {
-                assert(!other.auto_release);
-                this->auto_release  = other.auto_release;
-                this->count         = other.size();
-                this->prices        = other.prices;
-                this->count_ranges  = other.count_ranges;
-                this->counts       = other.counts;
-                return true;
-            }
-        }
+    InvoiceBatch batch(thread_count, random_seed, (cache_file != nullptr) ? &solution_cache : nullptr);
+    auto start_time = std::chrono::high_resolution_clock::now();
+    int result = batch.run(use_stdin ? std::cin : ifs, stdout);
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start_time;
+
+    fprintf(stderr, " batch: jobs = %u, found = %u, seed = %llu, time = %0.3f s\n",
+            (uint32_t)batch.job_count(), (uint32_t)batch.found_count(),
+            (unsigned long long)random_seed, elapsed.count());
+    return result;
+}
+
+// 126*212.09,243*172.10,227*226.68
+std::string format_answer_goods(const InvoiceBalance::GoodsList & answer)
+{
+    std::string goods;
+    char buf[64];
+    for (size_t i = 0; i < answer.size(); i++) {
+        snprintf(buf, sizeof(buf), "%s%u*%s", ((i != 0) ? "," : ""),
+                 (uint32_t)answer[i].count, answer[i].price.to_string().c_str());
+        goods += buf;
     }
+    return goods;
+}
 
-    void set_price_and_count(size_t goods_count, double goods_prices[],
-                             CountRange goods_count_ranges[] = nullptr,
-                             size_t goods_counts[] = nullptr) {
-        this->destroy();
+//
+// Daemon mode: a long running server with warm solvers. The requests are lines of "key=value"
+// fields, read from stdin (answered on stdout) or from the clients of a Unix domain socket:
+//
+//   id=7 total=120000.00 fluctuation=2.00 deadline=50 solver=random goods=212.00:100-,172.50,226.00:100-200
+//
+// Every request is answered by one line, as soon as it's solved (so not always in order):
+//
+//   id=7 status=found error=0.00 time_ms=0.215 goods=126*212.09,243*172.10,227*226.68
+//
+// The status is found, not_found, timeout (the best answer at the deadline), infeasible
+// (proved by the presolve, with reason= and nearest_total=) or invalid.
+// A client may send many requests without waiting for the answers, at most kRequestsPerWorker
+// per worker are queued, then the connections aren't read until the workers catch up. The
+// deadline (ms) is counted from the time the request is read.
+//
+class ServerConnection
+{
+private:
+    FILE *      in_;
+    FILE *      out_;
+    bool        owns_files_;
+    std::mutex  write_mutex_;
 
-        this->auto_release  = false;
-        this->count         = goods_count;
-        this->prices        = goods_prices;
-        this->count_ranges  = goods_count_ranges;
-        this->counts       = goods_counts;
+public:
+    ServerConnection(FILE * in, FILE * out, bool owns_files)
+        : in_(in), out_(out), owns_files_(owns_files) {
     }
 
-    bool create_price_amount(const GoodsInvoice & goods_list) {
-        bool result = this->copy(goods_list);
-        return result;
+    ~ServerConnection() {
+        if (this->owns_files_) {
+            if (this->in_ != nullptr)
+                fclose(this->in_);
+            if (this->out_ != nullptr)
+                fclose(this->out_);
+        }
     }
-};
 
-struct Goods {
-    double      price;
-    size_t      count;
-    CountRange  count_range;
+    bool read_line(std::string & line) {
+        char buf[4096];
+        line.clear();
+        while (fgets(buf, sizeof(buf), this->in_) != nullptr) {
+            line += buf;
+            if (!line.empty() && line[line.size() - 1] == '\n') {
+                line.resize(line.size() - 1);
+                if (!line.empty() && line[line.size() - 1] == '\r')
+                    line.resize(line.size() - 1);
+                return true;
+            }
+        }
+        return !line.empty();
+    }
 
-    Goods() : price(0.0), count(0) {
+    void write_line(const std::string & line) {
+        std::lock_guard<std::mutex> lock(this->write_mutex_);
+        fwrite(line.data(), 1, line.size(), this->out_);
+        fputc('\n', this->out_);
+        fflush(this->out_);
     }
 
-    double total_money() const {
-        return round_currency(this->price * this->count);
+    // Wakes up a read_line() waiting on a socket, it returns false. Not for the standard input.
+    void shutdown() {
+#if !defined(_WIN32)
+        if (this->owns_files_ && this->in_ != nullptr)
+            ::shutdown(fileno(this->in_), SHUT_RDWR);
+#endif
     }
 };
 
-class InvoiceBalance
+struct ServerRequest {
+    std::shared_ptr<ServerConnection>       conn;
+    std::string                             line;
+    std::chrono::steady_clock::time_point   received;
+};
+
+class InvoiceServer
 {
 public:
-    typedef std::vector<Goods>  GoodsList;
+    static const size_t kRequestsPerWorker = 64;
 
-private:    
-    double  total_amount_;
-    double  fluctuation_;
-    double  min_price_error_;
+private:
+    // A connection served on its own thread by add_connection().
+    struct ServerClient {
+        std::shared_ptr<ServerConnection>   conn;
+        std::thread                         thread;
+        std::atomic<bool>                   done;
+    };
 
-    size_t  goods_count_;
+    size_t                      thread_count_;
+    uint64_t                    random_seed_;
+    int64_t                     default_deadline_ms_;
+    SolutionCache *             solution_cache_;
 
-    GoodsList  input_goods_;
-    GoodsList  goods_list_;
-    GoodsList  best_answer_;
+    std::deque<ServerRequest>   requests_;
+    size_t                      max_requests_;
+    size_t                      busy_count_;
+    bool                        stop_;
 
-public:
-    InvoiceBalance()
-        : total_amount_(0.0), fluctuation_(0.0),
-          min_price_error_(std::numeric_limits<double>::max()), goods_count_(0) {
-    }
+    std::mutex                  mutex_;
+    std::condition_variable     request_ready_;
+    std::condition_variable     request_taken_;
+    std::condition_variable     idle_;
 
-    InvoiceBalance(double total_amount, double fluctuation)
-        : total_amount_(total_amount), fluctuation_(fluctuation),
-          min_price_error_(std::numeric_limits<double>::max()), goods_count_(0) {
-    }
+    std::vector<std::thread>    workers_;
 
-    virtual ~InvoiceBalance() {
-    }
+    std::list<std::unique_ptr<ServerClient>>    clients_;
+    std::mutex                                  clients_mutex_;
 
-    void set_total_amount(double total_amount, double fluctuation) {
-        this->total_amount_ = total_amount;
-        this->fluctuation_ = fluctuation;
+public:
+    InvoiceServer(size_t thread_count, uint64_t random_seed, int64_t default_deadline_ms,
+                  SolutionCache * solution_cache = nullptr)
+        : thread_count_(thread_count), random_seed_(random_seed),
+          default_deadline_ms_(default_deadline_ms), solution_cache_(solution_cache), busy_count_(0), stop_(false) {
+        if (this->thread_count_ == 0) {
+            this->thread_count_ = (std::max)((size_t)std::thread::hardware_concurrency(), size_t(1));
+        }
+        this->max_requests_ = this->thread_count_ * kRequestsPerWorker;
     }
 
-    void set_price_and_count(const GoodsList & goods_list) {
-        this->input_goods_ = goods_list;
-        this->goods_list_.resize(goods_list.size());
+    ~InvoiceServer() {
+        this->stop();
     }
 
-    bool normalize_prices() {
-        bool result = true;
-        this->fluctuation_ = round_currency(this->fluctuation_);
-        for (size_t i = 0; i < this->input_goods_.size(); i++) {
-            this->input_goods_[i].price = round_currency(this->input_goods_[i].price);
-            if (this->input_goods_[i].price < 0.0) {
-                this->input_goods_[i].price = 0.0;
-                result = false;
-            }
+    void start() {
+        RandomGenerator random(this->random_seed_);
+        for (size_t i = 0; i < this->thread_count_; i++) {
+            RandomGenerator stream = random.split();
+            this->workers_.push_back(std::thread([this, stream]() { this->worker(stream); }));
         }
-        return result;
     }
 
-private:
-    double calc_total_amount(const GoodsList & goods_list) {
-        double actual_total_amount = 0.0;
-        for (size_t i = 0; i < goods_list.size(); i++) {
-            double total = round_currency(goods_list[i].price * goods_list[i].count);
-            actual_total_amount += total;
+    //
+    // Stops reading the connections (they're shut down and their threads joined), then the
+    // workers answer the requests already queued and exit.
+    //
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex_);
+            this->stop_ = true;
+            this->request_ready_.notify_all();
+            this->request_taken_.notify_all();
         }
-        return actual_total_amount;
+        {
+            std::lock_guard<std::mutex> lock(this->clients_mutex_);
+            for (auto iter = this->clients_.begin(); iter != this->clients_.end(); ++iter) {
+                (*iter)->conn->shutdown();
+            }
+            for (auto iter = this->clients_.begin(); iter != this->clients_.end(); ++iter) {
+                (*iter)->thread.join();
+            }
+            this->clients_.clear();
+        }
+        for (size_t i = 0; i < this->workers_.size(); i++) {
+            this->workers_[i].join();
+        }
+        this->workers_.clear();
     }
 
-    double calc_min_total_amount(size_t idx, double total_amount, const GoodsList & goods_list) {
-        double actual_total_amount = 0.0;
-        for (size_t i = 0; i < goods_list.size(); i++) {
-            if (i == idx) continue;
-            int min_amount = (std::max)(goods_list[i].count_range.min, 1);
-            double money = round_currency(goods_list[i].price * min_amount);
-            actual_total_amount += money;
+    // Waits until all the requests are answered.
+    void drain() {
+        std::unique_lock<std::mutex> lock(this->mutex_);
+        while (!this->requests_.empty() || this->busy_count_ != 0) {
+            this->idle_.wait(lock);
         }
-        return actual_total_amount;
     }
 
-    int recalc_max_goods_count(const GoodsList & goods_list, size_t idx) {
-        double actual_total_amount = calc_total_amount(goods_list);
-        double min_total_amount = calc_min_total_amount(idx, this->total_amount_, goods_list);
-        return (int)((this->total_amount_ - actual_total_amount - min_total_amount) /
-                     (this->input_goods_[idx].price - this->fluctuation_));
+    // Serves a connection on its own thread, until it's closed or the server stops.
+    void add_connection(const std::shared_ptr<ServerConnection> & conn) {
+        std::lock_guard<std::mutex> lock(this->clients_mutex_);
+        this->join_closed_clients();
+
+        std::unique_ptr<ServerClient> client(new ServerClient);
+        ServerClient * client_ptr = client.get();
+        client->conn = conn;
+        client->done = false;
+        client->thread = std::thread([this, client_ptr]() {
+            this->serve(client_ptr->conn);
+            client_ptr->done = true;
+        });
+        this->clients_.push_back(std::move(client));
     }
 
-    void shuffle_goods_order(size_t goods_count, std::vector<size_t> & goods_orders) {
-        for (ptrdiff_t i = goods_count - 1; i >= 1; i--) {
-            ptrdiff_t idx = (ptrdiff_t)next_random_i64(0, i);
-            assert(idx >= 0 && idx < (ptrdiff_t)goods_count);
-            if (idx != i) {
-                std::swap(goods_orders[i], goods_orders[idx]);
+    //
+    // Reads the requests of a connection until it's closed or the server stops. It waits
+    // while the queue is full, so a client sending faster than the workers is slowed down.
+    //
+    void serve(const std::shared_ptr<ServerConnection> & conn) {
+        ServerRequest request;
+        request.conn = conn;
+        while (conn->read_line(request.line)) {
+            if (IniFile::skip_whitespace_chars(request.line) == std::string::npos)
+                continue;
+            request.received = std::chrono::steady_clock::now();
+            std::unique_lock<std::mutex> lock(this->mutex_);
+            while (this->requests_.size() >= this->max_requests_ && !this->stop_) {
+                this->request_taken_.wait(lock);
             }
+            if (this->stop_)
+                break;
+            this->requests_.push_back(request);
+            this->request_ready_.notify_one();
         }
     }
 
-    size_t find_unique_padding_idx(const GoodsList & goods_list) {
-        size_t count = 0;
-        size_t padding_idx = size_t(-1);
-        for (size_t i = 0; i < goods_list.size(); i++) {
-            if (goods_list[i].count == 0.0) {
-                if (count == 0)
-                    padding_idx = i;
-                count++;
+private:
+    // Joins the threads of the connections which are closed, clients_mutex_ is held.
+    void join_closed_clients() {
+        auto iter = this->clients_.begin();
+        while (iter != this->clients_.end()) {
+            if ((*iter)->done) {
+                (*iter)->thread.join();
+                iter = this->clients_.erase(iter);
+            }
+            else {
+                ++iter;
             }
         }
-        return ((count == 1) ? padding_idx : size_t(-1));
-    }
-
-    bool record_min_price_error(double price_error, const GoodsList & goods_list) {
-        bool is_better = false;
-        if (abs(price_error) < this->min_price_error_) {
-            this->min_price_error_ = abs(price_error);
-            this->best_answer_ = goods_list;
-            is_better = true;
-        }
-        return is_better;
     }
 
-    int adjust_price_and_count(double total_amount, double fluctuation,
-                               GoodsList & goods_list) {
-        int result = 0;
-        size_t padding_idx = find_unique_padding_idx(goods_list);
-        if (padding_idx == size_t(-1)) {
-            return -1;
-        }
-        ptrdiff_t padding_count = -1;
-        double actual_total_amount = calc_total_amount(goods_list);
-        if (actual_total_amount <= total_amount) {
-            padding_count = (ptrdiff_t)((total_amount - actual_total_amount) / goods_list[padding_idx].price);
-            goods_list[padding_idx].count = padding_count;
-            if (padding_count <= 0 || padding_count < (ptrdiff_t)goods_list[padding_idx].count_range.min) {
-                return -1;
+    void worker(RandomGenerator random) {
+        // The warm solver and the buffers of this worker, reused by all its requests.
+        InvoiceBalance balance;
+        balance.set_verbose(false);
+        balance.set_solution_cache(this->solution_cache_);
+        balance.set_random_seed(random.next_random64());
+        std::vector<Goods> goods_list;
+        std::string response;
+
+        for (;;) {
+            ServerRequest request;
+            {
+                std::unique_lock<std::mutex> lock(this->mutex_);
+                while (this->requests_.empty() && !this->stop_) {
+                    this->request_ready_.wait(lock);
+                }
+                if (this->requests_.empty())
+                    break;
+                request = std::move(this->requests_.front());
+                this->requests_.pop_front();
+                this->busy_count_++;
+                this->request_taken_.notify_one();
             }
-        }
-        else {
-            return -1;
-        }
 
-        actual_total_amount = calc_total_amount(goods_list);
-        double actual_price_diff = actual_total_amount - total_amount;
-        record_min_price_error(actual_price_diff, goods_list);
+            this->solve_request(balance, goods_list, request, response);
+            request.conn->write_line(response);
+            request.conn.reset();
 
-        for (size_t i = 0; i < goods_list.size(); i++) {
-            double price_adjust = round_currency(actual_price_diff / goods_list[i].price);
-            double old_price = goods_list[i].price;
-            goods_list[i].price -= price_adjust;
-            double price_diff = actual_total_amount - price_adjust * goods_list[i].count - total_amount;
-            record_min_price_error(price_diff, goods_list);
-            goods_list[i].price = old_price;
+            std::lock_guard<std::mutex> lock(this->mutex_);
+            this->busy_count_--;
+            if (this->requests_.empty() && this->busy_count_ == 0)
+                this->idle_.notify_all();
         }
-
-        return result;
     }
 
-    bool search_price_and_amount() {
-        bool solvable = false;
-
-        double total_amount = this->total_amount_;
-        double fluctuation = this->fluctuation_;
-        size_t goods_count = this->goods_list_.size();
-
-        size_t search_cnt = 0;
-        double price_error = std::numeric_limits<double>::max();
-        double min_price_error = std::numeric_limits<double>::max();
-        std::vector<size_t> goods_orders;
-        goods_orders.resize(goods_count);
-
-        while (price_error != 0.0) {
-            bool retry_next = false;
-            for (size_t i = 0; i < goods_count; i++) {
-                double price_change = normal_dist_random_f(-this->fluctuation_, this->fluctuation_);
-                this->goods_list_[i].price = round_currency(this->input_goods_[i].price + price_change);
+    void solve_request(InvoiceBalance & balance, std::vector<Goods> & goods_list,
+                       const ServerRequest & request, std::string & response) {
+        std::string id, reason;
+        Money total_amount(0);
+        Money fluctuation = Money::from_yuan(kDefaultFluctuation);
+        int64_t deadline_ms = this->default_deadline_ms_;
+        int solver_mode = SolverMode::Random;
+        bool print_stats = false;
+        Money target_error(0);
+        goods_list.clear();
+
+        const std::string & line = request.line;
+        size_t pos = 0;
+        while (pos < line.size()) {
+            while (pos < line.size() && (line[pos] == ' ' || line[pos] == '\t'))
+                pos++;
+            size_t end = pos;
+            while (end < line.size() && line[end] != ' ' && line[end] != '\t')
+                end++;
+            if (end == pos)
+                break;
+            size_t equal = line.find('=', pos);
+            if (equal == std::string::npos || equal >= end) {
+                reason = "bad_field";
+                break;
             }
+            std::string key = line.substr(pos, equal - pos);
+            std::string value = line.substr(equal + 1, end - equal - 1);
+            pos = end;
 
-            for (size_t i = 0; i < goods_count; i++) {
-                this->goods_list_[i].count = 0;
-                goods_orders[i] = i;
+            if (key == "id") {
+                id = value;
             }
-
-            // shuffle goods_order[]
-            shuffle_goods_order(goods_count, goods_orders);
-            
-            for (ptrdiff_t i = goods_count - 1; i >= 1; i--) {
-                size_t idx = goods_orders[i];
-                assert(this->goods_list_[idx].count == 0.0);
-                int min_amount = this->goods_list_[idx].count_range.min;
-                int max_amount = this->goods_list_[idx].count_range.max;
-                int actual_max_goods_amount = recalc_max_goods_count(this->goods_list_, idx);
-                min_amount = (std::max)(min_amount, 1);
-                if (max_amount >= min_amount)
-                    max_amount = (std::min)(max_amount, actual_max_goods_amount);
-                else
-                    max_amount = actual_max_goods_amount;
-                retry_next = (min_amount > max_amount);
-                if (retry_next) {
-                    break;
-                }
-                int rand_amount = normal_dist_random_i32(min_amount, max_amount);
-                assert(rand_amount >= min_amount);
-                this->goods_list_[idx].count = rand_amount;                
+            else if (key == "total") {
+                if (!Money::parse(value, total_amount) || total_amount <= Money(0))
+                    reason = "bad_total";
             }
-
-            if (!retry_next) {
-                int result = adjust_price_and_count(total_amount, fluctuation, this->goods_list_);
-                if (result == 0) {
-                    // Adjust success, have no overflow
-                }
+            else if (key == "fluctuation") {
+                if (!Money::parse(value, fluctuation))
+                    reason = "bad_fluctuation";
             }
-
-            search_cnt++;
-            if (this->min_price_error_ <= 0.0000001) {
-                solvable = true;
-                break;
+            else if (key == "deadline") {
+                deadline_ms = (int64_t)std::strtoll(value.c_str(), nullptr, 10);
             }
-            if (search_cnt > 1000000) {
-                break;
+            else if (key == "solver") {
+                solver_mode = parse_solver_mode(value, SolverMode::Random);
+            }
+            else if (key == "target_error") {
+                if (!Money::parse(value, target_error))
+                    reason = "bad_target_error";
+            }
+            else if (key == "stats") {
+                print_stats = (std::atoi(value.c_str()) != 0);
+            }
+            else if (key == "goods") {
+                if (!parse_request_goods(value, goods_list))
+                    reason = "bad_goods";
             }
         }
+        if (reason.empty() && total_amount.is_zero())
+            reason = "no_total";
+        if (reason.empty() && goods_list.empty())
+            reason = "no_goods";
+
+        response = "id=" + id;
+        if (!reason.empty()) {
+            response += " status=invalid reason=" + reason;
+            return;
+        }
 
-        printf(" search_cnt = %u\n\n", (uint32_t)search_cnt);
-        return solvable;
+        balance.set_total_amount(total_amount, fluctuation);
+        balance.set_price_and_count(goods_list);
+        balance.set_collect_timing(print_stats);
+        balance.set_target_error(target_error);
+        if (deadline_ms > 0)
+            balance.set_deadline(request.received + std::chrono::milliseconds(deadline_ms));
+        else
+            balance.clear_deadline();
+
+        // The pool already uses all the cores, so does a portfolio of its own.
+        if (solver_mode == SolverMode::Parallel || solver_mode == SolverMode::Portfolio)
+            solver_mode = SolverMode::Random;
+        bool found = balance.search(solver_mode);
+
+        const char * status;
+        if (found)
+            status = "found";
+        else if (balance.is_proved_infeasible())
+            status = "infeasible";
+        else if (balance.is_deadline_passed())
+            status = "timeout";
+        else
+            status = "not_found";
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - request.received;
+        char buf[128];
+        snprintf(buf, sizeof(buf), " status=%s time_ms=%0.3f", status, elapsed.count());
+        response += buf;
+
+        if (balance.is_proved_infeasible()) {
+            const PresolveResult & presolve = balance.get_presolve_result();
+            response += std::string(" reason=") + presolve.reason_name();
+            response += " nearest_total=" + Money(presolve.nearest_total).to_string();
+        }
+        if (balance.has_best_answer()) {
+            response += " error=" + balance.get_price_error().to_string();
+            response += " goods=" + format_answer_goods(balance.get_best_answer());
+        }
+        if (print_stats) {
+            response += " stats=" + balance.get_search_stats().to_json();
+        }
     }
 
-    bool fast_search_price_and_amount() {
-        bool solvable = false;
+    // goods=212.00:100-,172.50,226.00:100-200
+    static bool parse_request_goods(const std::string & value, std::vector<Goods> & goods_list) {
+        size_t pos = 0;
+        while (pos <= value.size()) {
+            size_t end = value.find(',', pos);
+            if (end == std::string::npos)
+                end = value.size();
+            std::string item = value.substr(pos, end - pos);
+            pos = end + 1;
 
-        double total_amount = this->total_amount_;
-        double fluctuation = this->fluctuation_;
-        size_t goods_count = this->goods_list_.size();
-        size_t n = this->goods_list_.size();
-
-        std::vector<double> result;
-        std::vector<double> remains;
-        result.reserve(n);
-        remains.reserve(n);
-
-        double sum = 0.0;
-        for (size_t i = 0; i < n; i++) {
-            sum += this->goods_list_[i].price;
-            result.push_back(this->goods_list_[i].price);
-            this->goods_list_[i].count = 1;
-        }
-
-        double remain = 0;
-        for (intptr_t i = n - 1; i >= 0; i--) {
-            remain += this->goods_list_[i].price * this->goods_list_[i].count;
-            remains.push_back(remain);
+            Goods goods;
+            int range_min = 1, range_max = 0;
+            size_t colon = item.find(':');
+            std::string price = item.substr(0, colon);
+            if (!Money::parse(price, goods.price) || goods.price <= Money(0))
+                return false;
+            if (colon != std::string::npos) {
+                if (!parse_count_range(item.substr(colon + 1), range_min, range_max))
+                    return false;
+            }
+            goods.count = 0;
+            goods.count_range.min = range_min;
+            goods.count_range.max = range_max;
+            goods_list.push_back(goods);
+            if (goods_list.size() > kMaxRequestGoods)
+                return false;
         }
+        return true;
+    }
+};
 
-        size_t search_cnt = 0;
-        do {
-            double balance = total_amount;
-            for (size_t i = 0; i < n; i++) {
-                intptr_t max_count = (intptr_t)((balance - remains[i]) / this->goods_list_[i].price);
-                if (max_count <= 0) {
-                    search_cnt++;
-                    continue;
-                }
-                size_t count = normal_dist_random_64(1, (size_t)max_count);
-                this->goods_list_[i].count = count;
-                balance -= this->goods_list_[i].price * count;
-            }
+#if !defined(_WIN32)
+int serve_unix_socket(InvoiceServer & server, const char * socket_path)
+{
+    int listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        fprintf(stderr, " socket() failed: %s\n", strerror(errno));
+        return -1;
+    }
 
-            double diff = balance;
-            if (diff < 0.0) {
-                diff = -diff;
-                // Add
-                for (size_t i = 0; i < n; i++) {
-                    double change = (std::min)(fluctuation, diff / this->goods_list_[i].count);
-                    double new_price = result[i];
-                    new_price += change;
-                    new_price = round_currency(new_price);
-                    change = new_price - result[i];
-                    result[i] = new_price;
-                    diff -= change * this->goods_list_[i].count;
-                }
-            } else {
-                // Sub
-                for (size_t i = 0; i < n; i++) {
-                    double change = (std::min)(fluctuation, diff / this->goods_list_[i].count);
-                    double new_price = result[i];
-                    new_price -= change;
-                    new_price = round_currency(new_price);
-                    change = new_price - result[i];
-                    result[i] = new_price;
-                    diff -= change * this->goods_list_[i].count;
-                }
-            }
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, " The socket path is too long: %s\n", socket_path);
+        ::close(listen_fd);
+        return -1;
+    }
+    strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+    ::unlink(socket_path);
 
-            double actual_total = calc_total_amount(this->goods_list_);
-            double total_diff = actual_total - total_amount;
-            record_min_price_error(total_diff, this->goods_list_);
+    if (::bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || ::listen(listen_fd, 64) != 0) {
+        fprintf(stderr, " bind() or listen() failed: %s\n", strerror(errno));
+        ::close(listen_fd);
+        return -1;
+    }
 
-            if (abs(total_diff) <= 0.0000001) {
-                solvable = true;
-                break;
+    int backoff_ms = 0;
+    for (;;) {
+        int fd = ::accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            // A client gone before it's accepted.
+            if (errno == EINTR || errno == ECONNABORTED || errno == EPROTO)
+                continue;
+            // Out of descriptors or memory for a while, the connections open now will close.
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                backoff_ms = (backoff_ms == 0) ? 10 : (std::min)(backoff_ms * 2, 1000);
+                fprintf(stderr, " accept() failed: %s, retry in %d ms\n", strerror(errno), backoff_ms);
+                std::this_thread::sleep_for(std::chrono::milliseconds(backoff_ms));
+                continue;
             }
+            fprintf(stderr, " accept() failed: %s\n", strerror(errno));
+            break;
+        }
+        backoff_ms = 0;
+        int out_fd = ::dup(fd);
+        FILE * in = ::fdopen(fd, "r");
+        FILE * out = (out_fd >= 0) ? ::fdopen(out_fd, "w") : nullptr;
+        if (in == nullptr || out == nullptr) {
+            if (in != nullptr) fclose(in); else ::close(fd);
+            if (out != nullptr) fclose(out); else if (out_fd >= 0) ::close(out_fd);
+            continue;
+        }
+        std::shared_ptr<ServerConnection> conn = std::make_shared<ServerConnection>(in, out, true);
+        server.add_connection(conn);
+    }
 
-            search_cnt++;
-            if (search_cnt > 1000000) {
-                break;
-            }
-        } while (1);
+    ::close(listen_fd);
+    ::unlink(socket_path);
+    return -1;
+}
+#endif // !_WIN32
 
-        printf(" search_cnt = %u\n\n", (uint32_t)search_cnt);
-        return solvable;
+//
+// InvoiceBalance --daemon <socket path | ->  [--threads N] [--seed N] [--deadline MS] [--cache FILE]
+//
+int run_daemon(int argc, char * argv[])
+{
+    const char * socket_path = nullptr;
+    const char * cache_file = nullptr;
+    size_t thread_count = 0;
+    uint64_t random_seed = 0;
+    int64_t deadline_ms = 1000;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--daemon" && i + 1 < argc)
+            socket_path = argv[++i];
+        else if (arg == "--cache" && i + 1 < argc)
+            cache_file = argv[++i];
+        else if (arg == "--threads" && i + 1 < argc)
+            thread_count = (size_t)std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--seed" && i + 1 < argc)
+            random_seed = (uint64_t)std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--deadline" && i + 1 < argc)
+            deadline_ms = (int64_t)std::strtoll(argv[++i], nullptr, 10);
+    }
+    if (socket_path == nullptr) {
+        fprintf(stderr, " Usage: InvoiceBalance --daemon <socket path | -> [--threads N] [--seed N] [--deadline MS] [--cache FILE]\n");
+        return -1;
     }
 
-    void display_best_answer() {
-        printf("\n");
-        printf("   #        amount         price           money\n");
-        printf("---------------------------------------------------------------\n\n");
-        double actual_total_amount = calc_total_amount(this->best_answer_);
-        for (size_t i = 0; i < this->best_answer_.size(); i++) {
-            printf("  %2u     %8u       %8.2f       %10.2f\n",
-                   (uint32_t)(i + 1),
-                   (uint32_t)this->best_answer_[i].count,
-                   this->best_answer_[i].price,
-                   this->best_answer_[i].total_money());
-        }
-        printf("\n");
-        printf(" Total                                 %10.2f\n", actual_total_amount);
-        printf("---------------------------------------------------------------\n");
-        printf(" Error                                 %10.2f\n", (actual_total_amount - this->total_amount_));
-        printf("\n\n");
-        printf("---------------------------------------------------------------\n");
-        printf(" The best price error:  %0.16f\n", this->min_price_error_);
-        printf("---------------------------------------------------------------\n\n");
+    if (random_seed == 0) {
+        random_seed = (uint64_t)std::chrono::high_resolution_clock::now().time_since_epoch().count();
     }
 
-public:
-    int solve() {
-        this->normalize_prices();
+    SolutionCache solution_cache;
+    if (cache_file != nullptr && !solution_cache.open(cache_file)) {
+        fprintf(stderr, " Can't open the cache file: %s\n", cache_file);
+        return -1;
+    }
 
-        bool solvable = search_price_and_amount();
-        if (solvable) {
-            printf(" Found a perfect answer.\n\n");
-        }
-        else {
-            printf(" Not found a perfect answer.\n\n");
-        }
+    InvoiceServer server(thread_count, random_seed, deadline_ms, (cache_file != nullptr) ? &solution_cache : nullptr);
+    server.start();
 
-        this->display_best_answer();
-        return (solvable ? 0 : 1);
+    int result = 0;
+    if (std::string(socket_path) == "-") {
+        std::shared_ptr<ServerConnection> conn = std::make_shared<ServerConnection>(stdin, stdout, false);
+        server.serve(conn);
+        server.drain();
+    }
+    else {
+#if !defined(_WIN32)
+        // A client closing its socket early mustn't kill the server.
+        ::signal(SIGPIPE, SIG_IGN);
+        result = serve_unix_socket(server, socket_path);
+#else
+        fprintf(stderr, " The Unix domain socket isn't supported on Windows, use '--daemon -'.\n");
+        result = -1;
+#endif
     }
 
-    int solve_fast() {
-        this->normalize_prices();
+    server.stop();
+    return result;
+}
 
-        bool solvable = fast_search_price_and_amount();
-        if (solvable) {
-            printf(" Found a perfect answer.\n\n");
-        }
-        else {
-            printf(" Not found a perfect answer.\n\n");
+//
+// Prints the perfect answers one per line: all of them (or the first answer_limit) as
+// they are found, or the top_k closest to the input prices.
+//
+int print_answers(InvoiceBalance & balance, size_t answer_limit, size_t top_k)
+{
+    size_t answer_count;
+    int status = ExactStatus::Found;
+    if (top_k != 0) {
+        std::vector<InvoiceBalance::GoodsList> answers;
+        answer_count = balance.top_answers(top_k, answers, &status);
+        for (size_t i = 0; i < answers.size(); i++) {
+            printf(" %u deviation=%s goods=%s\n", (uint32_t)(i + 1),
+                   balance.get_price_deviation(answers[i]).to_string().c_str(),
+                   format_answer_goods(answers[i]).c_str());
         }
-
-        this->display_best_answer();
-        return (solvable ? 0 : 1);
     }
-};
+    else {
+        size_t printed = 0;
+        answer_count = balance.enumerate_answers([&](const InvoiceBalance::GoodsList & answer) {
+            printf(" deviation=%s goods=%s\n", balance.get_price_deviation(answer).to_string().c_str(),
+                   format_answer_goods(answer).c_str());
+            printed++;
+            return (answer_limit == 0 || printed < answer_limit);
+        }, &status);
+    }
+    printf("\n answers = %u\n", (uint32_t)answer_count);
+    // Out of time, the answers above are only the ones enumerated so far.
+    if (status == ExactStatus::Timeout)
+        printf(" status = timeout\n");
+    else if (status == ExactStatus::TooLarge)
+        printf(" status = too_large\n");
+    printf("\n");
+    return ((answer_count != 0) ? 0 : 1);
+}
 
-double strToDouble(const std::string & value, double default_value)
+void print_invoice_result(const invoice_problem & problem, const invoice_result & result)
 {
-    if (value.empty() || value.c_str() == nullptr || value == "")
-        return default_value;
-    else
-        return std::stof(value.c_str());
+    printf("\n");
+    printf("   #        amount         price           money\n");
+    printf("---------------------------------------------------------------\n\n");
+    for (size_t i = 0; i < result.answer_count; i++) {
+        const invoice_answer_goods & goods = result.answer[i];
+        printf("  %2u     %8u       %8.2f       %10.2f\n",
+               (uint32_t)(i + 1),
+               (uint32_t)goods.count,
+               Money(goods.price).to_yuan(),
+               Money(goods.price * goods.count).to_yuan());
+    }
+    printf("\n");
+    printf(" Total                                 %10.2f\n", Money(result.actual_total).to_yuan());
+    printf("---------------------------------------------------------------\n");
+    printf(" Error                                 %10.2f\n",
+           Money(result.actual_total - problem.total_amount).to_yuan());
+    printf("\n\n");
+    printf("---------------------------------------------------------------\n");
+    printf(" The best price error:  %0.2f\n", Money(result.price_error).to_yuan());
+    printf("---------------------------------------------------------------\n\n");
 }
 
-bool parse_count_range(const std::string & value, int & min_val, int & max_val)
+// The INVOICE_SOLVER_* of a SolverMode, -1 (rejected by invoice_solver_solve) if it has none.
+int32_t to_invoice_solver(int solver_mode)
 {
-    bool is_ok = false;
-    size_t pos, start;
-    int min_value, max_value;
-    try {
-        start = IniFile::skip_whitespace_chars(value);
-        if (start != std::string::npos) {
-            pos = IniFile::find_char(value, start, '-');
-            if (pos != std::string::npos) {
-                std::string str_min, str_max;
-                // range: min value
-                IniFile::copy_string(value, str_min, start, pos);
-                if (str_min.size() > 0 && !str_min.empty()) {
-                    min_value = std::atoi(str_min.c_str());
-                    if (min_value > 0) {
-                        min_val = min_value;
-                        is_ok = true;
-                    }
-                }
-                // range: max value
-                IniFile::copy_string(value, str_max, pos + 1, value.size());
-                if (str_max.size() > 0 && !str_max.empty()) {
-                    max_value = std::stoi(str_max.c_str());
-                    if (max_value > 0) {
-                        max_val = max_value;
-                    }
-                }
-            }
-            else {
-                // range: min value
-                min_value = std::stoi(value.c_str() + start);
-                if (min_value > 0) {
-                    min_val = min_value;
-                    is_ok = true;
-                }
-            }
-        }
-    } catch (const std::invalid_argument & ex) {
-        std::cout << "std::invalid_argument::what(): " << ex.what() << '\n';
-    } catch (const std::out_of_range & ex) {
-        std::cout << "std::out_of_range::what(): " << ex.what() << '\n';
+    switch (solver_mode) {
+    case SolverMode::Random:
+        return INVOICE_SOLVER_RANDOM;
+    case SolverMode::Fast:
+        return INVOICE_SOLVER_FAST;
+    case SolverMode::Exact:
+        return INVOICE_SOLVER_EXACT;
+    case SolverMode::Parallel:
+        return INVOICE_SOLVER_PARALLEL;
+    case SolverMode::MeetInMiddle:
+        return INVOICE_SOLVER_MITM;
+    case SolverMode::BranchBound:
+        return INVOICE_SOLVER_BNB;
+    case SolverMode::Portfolio:
+        return INVOICE_SOLVER_PORTFOLIO;
+    default:
+        return -1;
     }
-    return is_ok;
 }
 
-struct AppConfig {
-    double total_amount;
-    double fluctuation;
+//
+// Solves one invoice through the C interface of the library, like any other client of it,
+// and prints the answer table. The exact solvers have no approximate answer to show.
+//
+int solve_invoice(const AppConfig & config, Money total_amount, Money fluctuation,
+                  const std::vector<Goods> & goods_list, uint64_t random_seed)
+{
+    std::vector<invoice_goods> goods(goods_list.size());
+    for (size_t i = 0; i < goods_list.size(); i++) {
+        goods[i].price = goods_list[i].price.cents;
+        goods[i].min_count = goods_list[i].count_range.min;
+        goods[i].max_count = goods_list[i].count_range.max;
+    }
 
-    std::vector<Goods> goods;
-};
+    invoice_problem problem;
+    invoice_problem_init(&problem);
+    problem.solver = to_invoice_solver(config.solver_mode);
+    problem.total_amount = total_amount.cents;
+    problem.fluctuation = fluctuation.cents;
+    problem.goods = goods.data();
+    problem.goods_count = goods.size();
+    problem.thread_count = (uint32_t)config.thread_count;
+    problem.collect_timing = config.print_stats ? 1 : 0;
+    problem.seed = random_seed;
+    problem.time_limit_ms = config.time_limit_ms;
+    problem.target_error = config.target_error.cents;
+
+    std::vector<invoice_answer_goods> answer(goods.size());
+    invoice_result result;
+    invoice_result_init(&result, answer.data(), answer.size());
+
+    std::unique_ptr<invoice_solver_handle, void (*)(invoice_solver_handle *)>
+        solver(invoice_solver_create(), invoice_solver_destroy);
+    if (!solver) {
+        printf(" Out of memory.\n\n");
+        return -1;
+    }
+    if (!config.cache_file.empty()) {
+        if (invoice_solver_open_cache(solver.get(), config.cache_file.c_str()) != INVOICE_STATUS_FOUND)
+            printf(" Can't open the cache file: %s\n\n", config.cache_file.c_str());
+    }
 
-size_t read_config_value(IniFile & iniFile, AppConfig & config)
-{
-    std::string value;
+    int32_t status = invoice_solver_solve(solver.get(), &problem, &result);
+    if (status < 0) {
+        printf(" Can't solve the invoice: %s\n\n", invoice_status_string(status));
+        return -1;
+    }
 
-    // TotalPrice
-    if (iniFile.contains("TotalAmount")) {
-        value = iniFile.values("TotalAmount");
-        config.total_amount = strToDouble(value, kDefaultTotalPrice);
+    if (result.from_cache) {
+        printf(" Found in the solution cache.\n\n");
     }
-    else {
-        config.total_amount = kDefaultTotalPrice;
+    if (status == INVOICE_STATUS_FOUND)
+        printf(" Found a perfect answer.\n\n");
+    else if (status == INVOICE_STATUS_INFEASIBLE)
+        printf(" There is no perfect answer: %s, the nearest total is %s.\n\n",
+               invoice_infeasible_reason_string(result.infeasible_reason),
+               Money(result.nearest_total).to_string().c_str());
+    else
+        printf(" Not found a perfect answer.\n\n");
+    if (result.answer_count != 0) {
+        print_invoice_result(problem, result);
     }
 
-    // Fluctuation
-    if (iniFile.contains("Fluctuation")) {
-        value = iniFile.values("Fluctuation");
-        config.fluctuation = strToDouble(value, kDefaultFluctuation);
+    if (config.print_stats) {
+        SearchStats stats;
+        stats.restarts = result.stats.restarts;
+        stats.rejected_restarts = result.stats.rejected_restarts;
+        stats.padding_out_of_range = result.stats.padding_out_of_range;
+        stats.improvements = result.stats.improvements;
+        stats.price_draw_ns = result.stats.price_draw_ns;
+        stats.count_draw_ns = result.stats.count_draw_ns;
+        stats.adjust_ns = result.stats.adjust_ns;
+        printf(" stats = %s\n\n", stats.to_json().c_str());
     }
-    else {
-        config.fluctuation = kDefaultFluctuation;
+    return ((status == INVOICE_STATUS_FOUND) ? 0 : 1);
+}
+
+//
+// Splits an order over max_invoice_amount into several invoices (InvoiceSplitter), solves
+// them and prints each invoice, then the counts of each goods of all the invoices.
+//
+int solve_split_invoice(const AppConfig & config, Money total_amount, Money fluctuation,
+                        const std::vector<Goods> & goods_list, uint64_t random_seed)
+{
+    SolutionCache solution_cache;
+    InvoiceSplitter splitter;
+    splitter.set_max_invoice_amount(config.max_invoice_amount);
+    splitter.set_solver_mode(config.solver_mode);
+    splitter.set_thread_count(config.thread_count);
+    splitter.set_random_seed(random_seed);
+    splitter.set_time_limit(config.time_limit_ms);
+    splitter.set_target_error(config.target_error);
+    if (!config.cache_file.empty()) {
+        if (solution_cache.open(config.cache_file.c_str()))
+            splitter.set_solution_cache(&solution_cache);
+        else
+            printf(" Can't open the cache file: %s\n\n", config.cache_file.c_str());
     }
 
-    // Price list
-    size_t goods_count = 0;
-    for (size_t i = 0; i < kMaxGoodsCount; i++) {
-        std::string index_str = std::to_string(i + 1);
+    bool all_found = splitter.solve(total_amount, fluctuation, goods_list);
+    const std::vector<InvoiceSplitter::Invoice> & invoices = splitter.invoices();
+    printf(" The total %s is split into %u invoices of at most %s, rounds = %u.\n\n",
+           total_amount.to_string().c_str(), (uint32_t)invoices.size(),
+           config.max_invoice_amount.to_string().c_str(), (uint32_t)splitter.round_count());
+    const PresolveResult & presolve = splitter.get_presolve_result();
+    if (presolve.is_infeasible()) {
+        printf(" There is no perfect answer: %s, the nearest total is %s.\n\n",
+               presolve.reason_name(), Money(presolve.nearest_total).to_string().c_str());
+    }
 
-        std::string price_name = "Price";
-        std::string range_name = "Range";
-        price_name += index_str;
-        range_name += index_str;
+    std::vector<int64_t> goods_counts(goods_list.size(), 0);
+    Money actual_total(0);
+    for (size_t k = 0; k < invoices.size(); k++) {
+        const InvoiceSplitter::Invoice & invoice = invoices[k];
+        printf(" Invoice %u / %u: %s, %s.\n", (uint32_t)(k + 1), (uint32_t)invoices.size(),
+               invoice.total_amount.to_string().c_str(),
+               invoice.found ? "found a perfect answer" : "not found a perfect answer");
+        if (invoice.answer.empty()) {
+            printf("\n");
+            continue;
+        }
 
-        // Price ##
-        if (iniFile.contains(price_name)) {
-            value = iniFile.values(price_name);
-            double goods_price = strToDouble(value, 0.0);
-            if (goods_price != 0.0 && goods_price != NAN) {
-                Goods goods;
-                goods.price = round_currency(goods_price);
-                // Range ##
-                int range_min = 1, range_max = 0;
-                if (iniFile.contains(range_name)) {
-                    value = iniFile.values(range_name);
-                    bool is_ok = parse_count_range(value, range_min, range_max);
-                    if (is_ok) {
-                        // Read OK
-                    }
-                } 
-                goods.count_range.min = range_min;
-                goods.count_range.max = range_max;
-                config.goods.push_back(goods);
-                goods_count++;
-            }
+        Money invoice_total(0);
+        printf("\n");
+        printf("   #        amount         price           money\n");
+        printf("---------------------------------------------------------------\n\n");
+        for (size_t i = 0; i < invoice.answer.size(); i++) {
+            const Goods & goods = invoice.answer[i];
+            printf("  %2u     %8u       %8.2f       %10.2f\n",
+                   (uint32_t)(invoice.goods_index[i] + 1), (uint32_t)goods.count,
+                   goods.price.to_yuan(), goods.total_money().to_yuan());
+            goods_counts[invoice.goods_index[i]] += (int64_t)goods.count;
+            invoice_total += goods.total_money();
         }
+        printf("\n");
+        printf(" Total                                 %10.2f\n", invoice_total.to_yuan());
+        printf(" Error                                 %10.2f\n\n", (invoice_total - invoice.total_amount).to_yuan());
+        actual_total += invoice_total;
     }
 
-    return goods_count;
+    printf("---------------------------------------------------------------\n");
+    printf("   #        amount         range\n");
+    printf("---------------------------------------------------------------\n\n");
+    for (size_t i = 0; i < goods_list.size(); i++) {
+        const CountRange & count_range = goods_list[i].count_range;
+        if (count_range.max >= count_range.min)
+            printf("  %2u     %8lld       %d-%d\n", (uint32_t)(i + 1), (long long)goods_counts[i],
+                   count_range.min, count_range.max);
+        else
+            printf("  %2u     %8lld       %d-\n", (uint32_t)(i + 1), (long long)goods_counts[i],
+                   count_range.min);
+    }
+    printf("\n");
+    printf(" Total                                 %10.2f\n", actual_total.to_yuan());
+    printf(" Error                                 %10.2f\n", (actual_total - total_amount).to_yuan());
+    printf("---------------------------------------------------------------\n\n");
+    return (all_found ? 0 : 1);
 }
 
+//
+// InvoiceBalance [--time-limit MS] [--target-error X] [--max-invoice-amount X] [--answers N] [--top K],
+// the options override Invoice.txt
+//
 int main(int argc, char * argv[])
 {
-    ::srand((unsigned int)::time(NULL));
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--batch")
+            return run_batch(argc, argv);
+        else if (std::string(argv[i]) == "--daemon")
+            return run_daemon(argc, argv);
+    }
 
     AppConfig config;
+    config.solver_mode = SolverMode::Random;
+    config.thread_count = 0;
+    config.random_seed = 0;
+    config.print_stats = false;
+    config.time_limit_ms = 0;
+    config.target_error = Money(0);
+    config.max_invoice_amount = Money(0);
     size_t nGoodsCount = size_t(-1);
 
     IniFile iniFile;
@@ -968,31 +1466,72 @@ int main(int argc, char * argv[])
         }
     }
 
-    InvoiceBalance goods_listBalance;
+    size_t answer_limit = 0, top_k = 0;
+    bool list_answers = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--answers" && i + 1 < argc) {
+            answer_limit = (size_t)std::strtoull(argv[++i], nullptr, 10);
+            list_answers = true;
+        }
+        else if (arg == "--top" && i + 1 < argc) {
+            top_k = (size_t)std::strtoull(argv[++i], nullptr, 10);
+            list_answers = (top_k != 0);
+        }
+        else if (arg == "--time-limit" && i + 1 < argc)
+            config.time_limit_ms = (int64_t)std::strtoll(argv[++i], nullptr, 10);
+        else if (arg == "--target-error" && i + 1 < argc)
+            config.target_error = strToMoney(argv[++i], Money(0));
+        else if (arg == "--max-invoice-amount" && i + 1 < argc)
+            config.max_invoice_amount = strToMoney(argv[++i], Money(0));
+    }
+
+    Money total_amount, fluctuation;
+    std::vector<Goods> goods_list;
     if (nGoodsCount != size_t(-1)) {
-        goods_listBalance.set_total_amount(config.total_amount, config.fluctuation);
-        goods_listBalance.set_price_and_count(config.goods);
+        total_amount = config.total_amount;
+        fluctuation = config.fluctuation;
+        goods_list = config.goods;
+        if (!has_positive_prices(goods_list)) {
+            fprintf(stderr, " Invoice.txt: every Price## must be above 0.00\n");
+            return -1;
+        }
     }
     else {
         // Get the default prices and count ranges
-        std::vector<Goods> goods_list;
         size_t min_goods_count = (std::min)(_countof(default_goods_prices), _countof(default_goods_count_range));
         for (size_t i = 0; i < min_goods_count; i++) {
             Goods goods;
-            goods.price = default_goods_prices[i];
+            goods.price = Money::from_yuan(default_goods_prices[i]);
             goods.count = 0;
             goods.count_range = default_goods_count_range[i];
             goods_list.push_back(goods);
         }
-        goods_listBalance.set_total_amount(kDefaultTotalPrice, kDefaultFluctuation);
-        goods_listBalance.set_price_and_count(goods_list);
+        total_amount = Money::from_yuan(kDefaultTotalPrice);
+        fluctuation = Money::from_yuan(kDefaultFluctuation);
     }
 
-#if 1
-    int result = goods_listBalance.solve();
-#else
-    int result = goods_listBalance.solve_fast();
-#endif
+    uint64_t random_seed = config.random_seed;
+    if (random_seed == 0) {
+        random_seed = (uint64_t)std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    }
+    // Print the seed, so a failed run can be replayed with 'Seed = xxxx'.
+    printf(" seed = %llu\n\n", (unsigned long long)random_seed);
+
+    int result;
+    if (list_answers) {
+        InvoiceBalance balance;
+        balance.set_total_amount(total_amount, fluctuation);
+        balance.set_price_and_count(goods_list);
+        balance.set_time_limit(config.time_limit_ms);
+        result = print_answers(balance, answer_limit, top_k);
+    }
+    else if (InvoiceSplitter::invoice_count(total_amount, config.max_invoice_amount) > 1) {
+        result = solve_split_invoice(config, total_amount, fluctuation, goods_list, random_seed);
+    }
+    else {
+        result = solve_invoice(config, total_amount, fluctuation, goods_list, random_seed);
+    }
 
 #if defined(_MSC_VER) && defined(_DEBUG)
     ::system("pause");
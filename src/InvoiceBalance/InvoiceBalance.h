@@ -0,0 +1,1437 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+#include <assert.h>
+
+#include <limits>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+
+#include "Money.h"
+#include "Random.h"
+#include "ExactSolver.h"
+#include "MeetInMiddleSolver.h"
+#include "BranchBoundSolver.h"
+#include "GcdSolver.h"
+#include "GreedyFillSolver.h"
+#include "PortfolioSolver.h"
+#include "AnnealingSolver.h"
+#include "CancelToken.h"
+#include "Presolve.h"
+#include "CandidateBatch.h"
+#include "SearchCandidate.h"
+#include "SolutionCache.h"
+#include "SearchStats.h"
+#include "AllocHook.h"
+
+struct CountRange {
+    int min;
+    int max;
+
+    CountRange() : min(0), max(0) {}
+    CountRange(int min, int max) : min(min), max(max) {}
+    CountRange(const CountRange & src) : min(src.min), max(src.max) {}
+
+    CountRange & operator = (const CountRange & rhs) {
+        if (&rhs != this) {
+            this->min = rhs.min;
+            this->max = rhs.max;
+        }
+        return *this;
+    }
+};
+
+// The restarts of a search without a deadline or a time limit.
+static const size_t kMaxSearchCount = 1000000;
+
+struct RoundingType {
+    enum {
+        RoundDown,
+        RoundUp,
+        HalfAdjust
+    };
+};
+
+struct SolverMode {
+    enum {
+        Random,
+        Fast,
+        Exact,
+        Parallel,
+        MeetInMiddle,
+        BranchBound,
+        Portfolio
+    };
+};
+
+inline double round_currency(double price, double precision = 100.0, int round_type = RoundingType::HalfAdjust)
+{
+    if (round_type == RoundingType::RoundDown)
+        return floor(price * precision) / precision;
+    else if (round_type == RoundingType::RoundUp)
+        return ceil(price * precision) / precision;
+    else
+        return floor(price * precision + 0.5) / precision;
+}
+
+struct GoodsInvoice
+{
+    bool            auto_release;
+    size_t          count;
+    double *        prices;
+    size_t *        counts;
+    CountRange *    count_ranges;
+
+    GoodsInvoice() : auto_release(false), count(0),
+                     prices(nullptr), counts(nullptr), count_ranges(nullptr) {
+    }
+
+    GoodsInvoice(size_t goods_count, double goods_prices[],
+                 CountRange goods_count_ranges[] = nullptr,
+                 size_t goods_counts[] = nullptr)
+        : auto_release(false), count(goods_count),
+          prices(goods_prices), counts(goods_counts), count_ranges(goods_count_ranges) {
+    }
+
+    GoodsInvoice(const GoodsInvoice & other)
+        : auto_release(false), count(0),
+          prices(nullptr), counts(nullptr), count_ranges(nullptr) {
+        this->construct_copy(other);
+    }
+
+    ~GoodsInvoice() {
+        this->destroy();
+    }
+
+    size_t size() const {
+        return this->count;
+    }
+
+    double moneys(size_t index) const {
+        assert(index < this->count);
+        return round_currency(this->prices[index] * this->counts[index]);
+    }
+
+    void destroy() {
+        if (this->auto_release) {
+            if (this->prices) {
+                delete[] this->prices;
+                this->prices = nullptr;
+            }
+            if (this->counts) {
+                delete[] this->counts;
+                this->counts = nullptr;
+            }
+            if (this->count_ranges) {
+                delete[] this->count_ranges;
+                this->count_ranges = nullptr;
+            }
+        }
+    }
+
+    GoodsInvoice & operator = (const GoodsInvoice & rhs) {
+        this->copy(rhs);
+        return *this;
+    }
+
+    void attach(const GoodsInvoice & other) {
+        if (&other != this) {
+            this->destroy();
+
+            this->auto_release  = false;
+            this->count         = other.size();
+            this->prices        = other.prices;
+            this->counts       = other.counts;
+            this->count_ranges = other.count_ranges;
+        }
+    }
+
+    bool create_new_invoice(const GoodsInvoice & other) {
+        assert(other.size() != 0);
+        size_t goods_count = other.size();
+        this->auto_release = true;
+        this->count = goods_count;
+
+        // price
+        double * new_goods_prices = new double[goods_count];
+        if (new_goods_prices == nullptr) {
+            return false;
+        }
+
+        if (other.prices != nullptr) {
+            for (size_t i = 0; i < goods_count; i++) {
+                new_goods_prices[i] = other.prices[i];
+            }
+        }
+        else {
+            for (size_t i = 0; i < goods_count; i++) {
+                new_goods_prices[i] = 0.0;
+            }
+        }
+        this->prices = new_goods_prices;
+
+        // count
+        size_t * new_goods_counts = new size_t[goods_count];
+        if (new_goods_counts == nullptr) {
+            return false;
+        }
+
+        if (other.counts == nullptr) {
+            for (size_t i = 0; i < goods_count; i++) {
+                new_goods_counts[i] = 0;
+            }
+        }
+        else {
+            for (size_t i = 0; i < goods_count; i++) {
+                new_goods_counts[i] = other.counts[i];
+            }
+        }
+        this->counts = new_goods_counts;
+
+        // count range
+        CountRange * new_goods_count_ranges = new CountRange[goods_count];
+        if (new_goods_count_ranges == nullptr) {
+            return false;
+        }
+
+        if (other.count_ranges == nullptr) {
+            for (size_t i = 0; i < goods_count; i++) {
+                new_goods_count_ranges[i].min = 1;
+                new_goods_count_ranges[i].max = 0;
+            }
+        }
+        else {
+            for (size_t i = 0; i < goods_count; i++) {
+                new_goods_count_ranges[i] = other.count_ranges[i];
+            }
+        }
+        this->count_ranges = new_goods_count_ranges;
+
+        return true;
+    }
+
+    bool copy_invoice(const GoodsInvoice & other) {
+        assert(other.size() != 0);
+        assert(this->count == other.size());
+        size_t goods_count = other.size();
+        assert(this->auto_release);
+        this->auto_release = true;
+        this->count = goods_count;
+
+        // price
+        if (other.prices != nullptr) {
+            for (size_t i = 0; i < goods_count; i++) {
+                this->prices[i] = other.prices[i];
+            }
+        }
+        else {
+            for (size_t i = 0; i < goods_count; i++) {
+                this->prices[i] = 0.0;
+            }
+        }
+
+        // count
+        if (other.counts == nullptr) {
+            for (size_t i = 0; i < goods_count; i++) {
+                this->counts[i] = 0;
+            }
+        }
+        else {
+            for (size_t i = 0; i < goods_count; i++) {
+                this->counts[i] = other.counts[i];
+            }
+        }
+
+        // count range
+        if (other.count_ranges == nullptr) {
+            for (size_t i = 0; i < goods_count; i++) {
+                this->count_ranges[i].min = 1;
+                this->count_ranges[i].max = 0;
+            }
+        }
+        else {
+            for (size_t i = 0; i < goods_count; i++) {
+                this->count_ranges[i] = other.count_ranges[i];
+            }
+        }
+
+        return true;
+    }
+
+    void construct_copy(const GoodsInvoice & other) {
+        if (other.size() != 0) {
+            this->create_new_invoice(other);
+        }
+    }
+
+    bool internal_copy(const GoodsInvoice & other) {
+        bool success;
+        if (other.size() != 0) {
+            if (other.size() != this->count || !this->auto_release) {
+                this->destroy();
+                success = this->create_new_invoice(other);
+            }
+            else {
+                success = this->copy_invoice(other);
+            }
+        }
+        else {
+            this->destroy();
+            success = true;
+        }
+        return success;
+    }
+
+    bool copy(const GoodsInvoice & other) {
+        if (&other != this) {
+            return this->internal_copy(other);
+        }
+
+        return false;
+    }
+
+    bool clone(const GoodsInvoice & other) {
+        if (&other != this) {
+            if (other.auto_release) {
+                assert(other.auto_release);
+                return this->internal_copy(other);
+            }
+            else {
+                assert(!other.auto_release);
+                this->auto_release  = other.auto_release;
+                this->count         = other.size();
+                this->prices        = other.prices;
+                this->count_ranges  = other.count_ranges;
+                this->counts       = other.counts;
+                return true;
+            }
+        }
+    }
+
+    void set_price_and_count(size_t goods_count, double goods_prices[],
+                             CountRange goods_count_ranges[] = nullptr,
+                             size_t goods_counts[] = nullptr) {
+        this->destroy();
+
+        this->auto_release  = false;
+        this->count         = goods_count;
+        this->prices        = goods_prices;
+        this->count_ranges  = goods_count_ranges;
+        this->counts       = goods_counts;
+    }
+
+    bool create_price_amount(const GoodsInvoice & goods_list) {
+        bool result = this->copy(goods_list);
+        return result;
+    }
+};
+
+struct Goods {
+    Money       price;
+    size_t      count;
+    CountRange  count_range;
+
+    Goods() : price(0), count(0) {
+    }
+
+    Money total_money() const {
+        return (this->price * (int64_t)this->count);
+    }
+};
+
+class InvoiceBalance
+{
+public:
+    typedef std::vector<Goods>  GoodsList;
+
+private:    
+    Money   total_amount_;
+    Money   fluctuation_;
+
+    size_t  goods_count_;
+
+    GoodsList  input_goods_;
+    GoodsList  goods_list_;
+
+    RandomGenerator random_;
+
+    BatchKernel     batch_kernel_;
+    const char *    batch_kernel_name_;
+
+    // Print the search statistics and the messages of the search.
+    bool            verbose_;
+
+    // The searches give up at the deadline (if any), with the best answer found so far.
+    bool                                    has_deadline_;
+    std::chrono::steady_clock::time_point   deadline_;
+
+    // The time budget of each search in ms (0 is none), and the error that is good enough
+    // to stop at. A search with a deadline or a time limit has no restart cap, it runs
+    // until the time is out or the target error is reached.
+    int64_t                                 time_limit_ms_;
+    Money                                   target_error_;
+
+    // The deadline of the running search, the earlier of deadline_ and the time budget.
+    bool                                    has_search_deadline_;
+    std::chrono::steady_clock::time_point   search_deadline_;
+
+    // Kept between the searches, so a warm solver doesn't allocate them again.
+    CandidateBatch          candidate_batch_;
+    SearchCandidate         candidate_;
+    ExactSolver             exact_solver_;
+    MeetInMiddleSolver      mitm_solver_;
+    BranchBoundSolver       bnb_solver_;
+    GcdSolver               gcd_solver_;
+    GreedyFillSolver        greedy_solver_;
+    AnnealingSolver         annealing_solver_;
+
+    // The perfect answers of the solved problems, shared by the solvers (not owned).
+    SolutionCache *         solution_cache_;
+
+    // The counters of the last search, the workers merge theirs under best_mutex_.
+    SearchStats             stats_;
+    bool                    from_cache_;
+    PresolveResult          presolve_;
+    bool                    collect_timing_;
+    std::atomic<uint64_t>   improvement_count_;
+
+    // The best answer is shared by all the search workers: the error (in cents) is a lock-free
+    // slot checked on every candidate, best_answer_ is only copied under the lock when it improves.
+    // cancel_token_ stops all the workers (and the exact solvers of a portfolio) once it's done.
+    std::atomic<int64_t>    min_price_error_;
+    CancelToken             cancel_token_;
+    std::mutex              best_mutex_;
+    GoodsList               best_answer_;
+
+public:
+    InvoiceBalance()
+        : total_amount_(0), fluctuation_(0), goods_count_(0),
+          verbose_(true), has_deadline_(false), time_limit_ms_(0), target_error_(0),
+          has_search_deadline_(false), solution_cache_(nullptr), from_cache_(false),
+          collect_timing_(false), improvement_count_(0), min_price_error_((std::numeric_limits<int64_t>::max)()) {
+        this->batch_kernel_ = select_batch_kernel(&this->batch_kernel_name_);
+    }
+
+    InvoiceBalance(Money total_amount, Money fluctuation)
+        : total_amount_(total_amount), fluctuation_(fluctuation), goods_count_(0),
+          verbose_(true), has_deadline_(false), time_limit_ms_(0), target_error_(0),
+          has_search_deadline_(false), solution_cache_(nullptr), from_cache_(false),
+          collect_timing_(false), improvement_count_(0), min_price_error_((std::numeric_limits<int64_t>::max)()) {
+        this->batch_kernel_ = select_batch_kernel(&this->batch_kernel_name_);
+    }
+
+    virtual ~InvoiceBalance() {
+    }
+
+    void set_total_amount(Money total_amount, Money fluctuation) {
+        this->total_amount_ = total_amount;
+        this->fluctuation_ = fluctuation;
+    }
+
+    // The same seed replays the same search (with one search thread).
+    void set_random_seed(uint64_t seed) {
+        this->random_.seed(seed);
+    }
+
+    uint64_t get_random_seed() const {
+        return this->random_.get_seed();
+    }
+
+    void set_verbose(bool verbose) {
+        this->verbose_ = verbose;
+    }
+
+    void set_solution_cache(SolutionCache * solution_cache) {
+        this->solution_cache_ = solution_cache;
+    }
+
+    // Measures the time of the search phases too, see SearchStats.
+    void set_collect_timing(bool collect_timing) {
+        this->collect_timing_ = collect_timing;
+    }
+
+    void set_deadline(std::chrono::steady_clock::time_point deadline) {
+        this->has_deadline_ = true;
+        this->deadline_ = deadline;
+    }
+
+    void clear_deadline() {
+        this->has_deadline_ = false;
+    }
+
+    void set_time_limit(int64_t time_limit_ms) {
+        this->time_limit_ms_ = (time_limit_ms > 0) ? time_limit_ms : 0;
+    }
+
+    // Stops the running enumerate_answers() (or top_answers()) from another thread, as the
+    // time limit does.
+    void cancel() {
+        this->cancel_token_.cancel();
+    }
+
+    void set_target_error(Money target_error) {
+        this->target_error_ = target_error.abs();
+    }
+
+    bool is_deadline_passed() const {
+        if (!this->has_deadline_ && !this->has_search_deadline_)
+            return false;
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        return ((this->has_deadline_ && now >= this->deadline_)
+                || (this->has_search_deadline_ && now >= this->search_deadline_));
+    }
+
+    void set_price_and_count(const GoodsList & goods_list) {
+        this->input_goods_ = goods_list;
+        this->goods_list_ = goods_list;
+    }
+
+    bool normalize_prices() {
+        bool result = true;
+        if (this->fluctuation_ < Money(0)) {
+            this->fluctuation_ = -this->fluctuation_;
+        }
+        for (size_t i = 0; i < this->input_goods_.size(); i++) {
+            if (this->input_goods_[i].price < Money(0)) {
+                this->input_goods_[i].price = Money(0);
+                result = false;
+            }
+        }
+        this->goods_list_ = this->input_goods_;
+        return result;
+    }
+
+    // The input goods of the invoice, in the arrays of a SearchCandidate.
+    void load_candidate(SearchCandidate & candidate) const {
+        size_t goods_count = this->input_goods_.size();
+        candidate.resize(goods_count);
+        candidate.set_total_amount(this->total_amount_.cents, this->fluctuation_.cents);
+        for (size_t i = 0; i < goods_count; i++) {
+            const Goods & goods = this->input_goods_[i];
+            candidate.set_goods(i, goods.price.cents, goods.count_range.min, goods.count_range.max);
+        }
+    }
+
+    // The batch of the SIMD kernel, sized for the input goods and their price bands.
+    void init_candidate_batch(CandidateBatch & batch) const {
+        size_t goods_count = this->input_goods_.size();
+        batch.resize(goods_count);
+        batch.total_amount = (double)this->total_amount_.cents;
+        for (size_t i = 0; i < goods_count; i++) {
+            Money min_price = this->input_goods_[i].price - this->fluctuation_;
+            Money max_price = this->input_goods_[i].price + this->fluctuation_;
+            batch.min_prices[i] = (double)(std::max)(min_price.cents, int64_t(1));
+            batch.max_prices[i] = (double)max_price.cents;
+        }
+    }
+
+    // The SIMD kernel of the random search, the fastest one this CPU supports.
+    BatchKernel get_batch_kernel() const {
+        return this->batch_kernel_;
+    }
+
+    const char * get_batch_kernel_name() const {
+        return this->batch_kernel_name_;
+    }
+
+    //
+    // max_search_cnt restarts of the random search alone (no presolve, cache or other solver),
+    // returns the restarts done, fewer if a perfect answer is found. InvoiceBench times it.
+    //
+    size_t run_random_restarts(size_t max_search_cnt) {
+        this->reset_best_answer();
+        return search_worker(this->random_, this->goods_list_,
+                             this->candidate_batch_, this->candidate_, max_search_cnt);
+    }
+
+private:
+    Money calc_total_amount(const GoodsList & goods_list) {
+        Money actual_total_amount(0);
+        for (size_t i = 0; i < goods_list.size(); i++) {
+            actual_total_amount += goods_list[i].total_money();
+        }
+        return actual_total_amount;
+    }
+
+    Money min_price_error() const {
+        return Money(this->min_price_error_.load());
+    }
+
+    bool record_min_price_error(Money price_error, const GoodsList & goods_list) {
+        return record_min_price_error(price_error, goods_list, size_t(-1), Money(0));
+    }
+
+    //
+    // The answer is goods_list with the price of goods_list[adjust_idx] replaced by adjust_price
+    // (no replacement if adjust_idx is -1), so the callers needn't mutate and restore their list.
+    // best_answer_ is sized by reset_best_answer(), the copy never allocates.
+    //
+    bool record_min_price_error(Money price_error, const GoodsList & goods_list,
+                                size_t adjust_idx, Money adjust_price) {
+        int64_t error = price_error.abs().cents;
+        int64_t min_error = this->min_price_error_.load(std::memory_order_relaxed);
+        while (error < min_error) {
+            if (this->min_price_error_.compare_exchange_weak(min_error, error)) {
+                std::lock_guard<std::mutex> lock(this->best_mutex_);
+                // A better answer may have been stored by another worker in the meantime.
+                if (error <= this->min_price_error_.load()) {
+                    assert(this->best_answer_.size() == goods_list.size());
+                    std::copy(goods_list.begin(), goods_list.end(), this->best_answer_.begin());
+                    if (adjust_idx != size_t(-1))
+                        this->best_answer_[adjust_idx].price = adjust_price;
+                }
+                if (error <= this->target_error_.cents) {
+                    this->cancel_token_.cancel();
+                }
+                this->improvement_count_.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //
+    // Only the candidates better than the current best answer are copied back to goods_list,
+    // and their totals are recomputed exactly in Money before they are recorded.
+    //
+    void record_batch_answers(const CandidateBatch & batch, GoodsList & goods_list, SearchStats & stats) {
+        const size_t K = CandidateBatch::kBatchSize;
+        size_t goods_count = goods_list.size();
+        for (size_t k = 0; k < batch.size; k++) {
+            double error = batch.errors[k];
+            if (error == CandidateBatch::invalid_error())
+                stats.padding_out_of_range++;
+            if (error >= (double)this->min_price_error_.load(std::memory_order_relaxed))
+                continue;
+
+            // A price of 0 or less is never an answer, whatever its error.
+            bool has_valid_prices = true;
+            for (size_t i = 0; i < goods_count; i++) {
+                goods_list[i].price = Money((int64_t)batch.prices[i * K + k]);
+                size_t count = (size_t)batch.counts[i * K + k];
+                goods_list[i].count = (count != 0) ? count : (size_t)batch.padding_counts[k];
+                if (goods_list[i].price <= Money(0))
+                    has_valid_prices = false;
+            }
+            if (!has_valid_prices)
+                continue;
+
+            Money price_diff = calc_total_amount(goods_list) - this->total_amount_;
+            ptrdiff_t adjust_idx = (ptrdiff_t)batch.adjust_indexes[k];
+            if (adjust_idx >= 0) {
+                int64_t count = (int64_t)goods_list[adjust_idx].count;
+                Money price_adjust((-price_diff.cents + count / 2) / count);
+                record_min_price_error(price_diff + price_adjust * count, goods_list,
+                                       (size_t)adjust_idx, goods_list[adjust_idx].price + price_adjust);
+            }
+            else {
+                record_min_price_error(price_diff, goods_list);
+            }
+        }
+    }
+
+    //
+    // One randomized restart loop on its own scratch goods list, it stops when any worker
+    // has found a perfect answer or after max_search_cnt restarts. The candidates are drawn
+    // one by one, and evaluated CandidateBatch::kBatchSize at a time by the SIMD kernel.
+    // The counters of the worker are merged into stats_ at the end.
+    //
+    size_t search_worker(RandomGenerator & random, GoodsList & goods_list,
+                         CandidateBatch & batch, SearchCandidate & candidate,
+                         size_t max_search_cnt) {
+        this->load_candidate(candidate);
+
+        typedef std::chrono::steady_clock clock;
+        SearchStats stats;
+        bool collect_timing = this->collect_timing_;
+
+        size_t search_cnt = 0;
+        init_candidate_batch(batch);
+
+        // Everything is allocated above, the restart loop must not touch the heap.
+        size_t alloc_count = alloc_hook_count();
+
+        while (!this->cancel_token_.is_cancelled() && search_cnt < max_search_cnt) {
+            batch.size = 0;
+            while (!batch.full() && search_cnt < max_search_cnt) {
+                search_cnt++;
+                bool generated;
+                if (collect_timing) {
+                    clock::time_point start_time = clock::now();
+                    candidate.draw_prices(random);
+                    clock::time_point price_time = clock::now();
+                    generated = candidate.draw_counts(random);
+                    stats.price_draw_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(price_time - start_time).count();
+                    stats.count_draw_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - price_time).count();
+                }
+                else {
+                    candidate.draw_prices(random);
+                    generated = candidate.draw_counts(random);
+                }
+                if (generated) {
+                    candidate.store(batch);
+                }
+                else {
+                    stats.rejected_restarts++;
+                }
+            }
+
+            clock::time_point adjust_time;
+            if (collect_timing)
+                adjust_time = clock::now();
+            this->batch_kernel_(batch);
+            record_batch_answers(batch, goods_list, stats);
+            if (collect_timing)
+                stats.adjust_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - adjust_time).count();
+
+            if (this->is_deadline_passed()) {
+                this->cancel_token_.cancel();
+            }
+        }
+
+        alloc_hook_verify(alloc_count, "search_worker()");
+
+        stats.restarts = search_cnt;
+        std::lock_guard<std::mutex> lock(this->best_mutex_);
+        this->stats_.merge(stats);
+        return search_cnt;
+    }
+
+    void reset_best_answer() {
+        std::lock_guard<std::mutex> lock(this->best_mutex_);
+        this->min_price_error_.store((std::numeric_limits<int64_t>::max)());
+        this->cancel_token_.reset();
+        // Sized here, so recording a better answer is only a copy.
+        this->best_answer_ = this->input_goods_;
+    }
+
+    // Starts the time budget of a search.
+    void start_search_deadline() {
+        this->has_search_deadline_ = this->has_deadline_;
+        this->search_deadline_ = this->deadline_;
+        if (this->time_limit_ms_ > 0) {
+            std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now()
+                                                           + std::chrono::milliseconds(this->time_limit_ms_);
+            if (!this->has_search_deadline_ || deadline < this->search_deadline_)
+                this->search_deadline_ = deadline;
+            this->has_search_deadline_ = true;
+        }
+    }
+
+    size_t max_search_count() const {
+        return (this->has_search_deadline_ ? (std::numeric_limits<size_t>::max)() : kMaxSearchCount);
+    }
+
+    bool search_price_and_amount() {
+        this->reset_best_answer();
+
+        size_t search_cnt = search_worker(this->random_, this->goods_list_,
+                                          this->candidate_batch_, this->candidate_, this->max_search_count());
+
+        if (this->verbose_) {
+            printf(" search_cnt = %u, kernel = %s\n\n", (uint32_t)search_cnt, this->batch_kernel_name_);
+        }
+        return (this->min_price_error() == Money(0));
+    }
+
+    bool parallel_search_price_and_amount(size_t thread_count) {
+        this->reset_best_answer();
+
+        if (thread_count == 0) {
+            thread_count = (std::max)((size_t)std::thread::hardware_concurrency(), size_t(1));
+        }
+
+        // The restart budget is shared by the workers.
+        size_t max_search_cnt = this->max_search_count();
+        if (max_search_cnt != (std::numeric_limits<size_t>::max)())
+            max_search_cnt = (max_search_cnt + thread_count - 1) / thread_count;
+
+        // Each worker has its own scratch list and its own random stream.
+        std::vector<GoodsList> scratch_lists(thread_count, this->goods_list_);
+        std::vector<RandomGenerator> randoms;
+        randoms.reserve(thread_count);
+        for (size_t i = 0; i < thread_count; i++) {
+            randoms.push_back(this->random_.split());
+        }
+        std::vector<size_t> search_counts(thread_count, 0);
+        std::vector<std::thread> workers;
+        workers.reserve(thread_count);
+
+        for (size_t i = 0; i < thread_count; i++) {
+            workers.push_back(std::thread([this, i, max_search_cnt, &randoms, &scratch_lists, &search_counts]() {
+                CandidateBatch batch;
+                SearchCandidate candidate;
+                search_counts[i] = this->search_worker(randoms[i], scratch_lists[i],
+                                                       batch, candidate, max_search_cnt);
+            }));
+        }
+        for (size_t i = 0; i < thread_count; i++) {
+            workers[i].join();
+        }
+
+        size_t search_cnt = 0;
+        for (size_t i = 0; i < thread_count; i++) {
+            search_cnt += search_counts[i];
+        }
+
+        if (this->verbose_) {
+            printf(" threads = %u, search_cnt = %u, kernel = %s\n\n",
+                   (uint32_t)thread_count, (uint32_t)search_cnt, this->batch_kernel_name_);
+        }
+        return (this->min_price_error() == Money(0));
+    }
+
+    bool fast_search_price_and_amount() {
+        this->reset_best_answer();
+
+        size_t search_cnt = fast_search_worker(this->random_, this->goods_list_, this->max_search_count());
+
+        if (this->verbose_) {
+            printf(" search_cnt = %u\n\n", (uint32_t)search_cnt);
+        }
+        return (this->min_price_error() == Money(0));
+    }
+
+    //
+    // The restarts of the fast search in goods_list, until a perfect answer, max_search_cnt
+    // restarts, the deadline or the cancellation. Its counters are merged into stats_.
+    //
+    size_t fast_search_worker(RandomGenerator & random, GoodsList & goods_list, size_t max_search_cnt) {
+        SearchStats stats;
+
+        Money total_amount = this->total_amount_;
+        Money fluctuation = this->fluctuation_;
+        size_t n = goods_list.size();
+
+        std::vector<Money> result;
+        std::vector<Money> remains;
+        result.reserve(n);
+
+        // The counts are drawn in their count ranges, from the minimum count up.
+        Money sum(0);
+        for (size_t i = 0; i < n; i++) {
+            sum += goods_list[i].price;
+            result.push_back(goods_list[i].price);
+            goods_list[i].count = (size_t)(std::max)(goods_list[i].count_range.min, 1);
+        }
+
+        // remains[i] is the minimum amount of the goods after goods i, which still need a count.
+        remains.resize(n, Money(0));
+        for (intptr_t i = (intptr_t)n - 2; i >= 0; i--) {
+            remains[i] = remains[i + 1] + goods_list[i + 1].total_money();
+        }
+
+        size_t search_cnt = 0;
+        do {
+            stats.restarts++;
+            Money balance = total_amount;
+            // A goods without room for its minimum count abandons the whole restart.
+            bool rejected = false;
+            for (size_t i = 0; i < n; i++) {
+                const CountRange & count_range = goods_list[i].count_range;
+                intptr_t min_count = (std::max)(count_range.min, 1);
+                intptr_t max_count = (intptr_t)((balance - remains[i]) / goods_list[i].price);
+                if (count_range.max >= min_count && count_range.max < max_count)
+                    max_count = count_range.max;
+                if (max_count < min_count) {
+                    rejected = true;
+                    break;
+                }
+                size_t count = random.normal_dist_random_64((size_t)min_count, (size_t)max_count);
+                goods_list[i].count = count;
+                balance -= goods_list[i].price * (int64_t)count;
+            }
+
+            if (rejected) {
+                stats.rejected_restarts++;
+            }
+            else {
+                Money diff = balance;
+                if (diff < Money(0)) {
+                    diff = -diff;
+                    // Add
+                    for (size_t i = 0; i < n; i++) {
+                        int64_t count = (int64_t)goods_list[i].count;
+                        Money change = (std::min)(fluctuation, Money(diff.cents / count));
+                        result[i] += change;
+                        diff -= change * count;
+                    }
+                } else {
+                    // Sub
+                    for (size_t i = 0; i < n; i++) {
+                        int64_t count = (int64_t)goods_list[i].count;
+                        Money change = (std::min)(fluctuation, Money(diff.cents / count));
+                        result[i] -= change;
+                        diff -= change * count;
+                    }
+                }
+
+                Money actual_total = calc_total_amount(goods_list);
+                Money total_diff = actual_total - total_amount;
+                record_min_price_error(total_diff, goods_list);
+
+                if (total_diff.is_zero()) {
+                    break;
+                }
+            }
+
+            search_cnt++;
+            if (search_cnt >= max_search_cnt || this->cancel_token_.is_cancelled()) {
+                break;
+            }
+            if ((search_cnt % CandidateBatch::kBatchSize) == 0 && this->is_deadline_passed()) {
+                break;
+            }
+        } while (1);
+
+        std::lock_guard<std::mutex> lock(this->best_mutex_);
+        this->stats_.merge(stats);
+        return search_cnt;
+    }
+
+    void make_exact_items(std::vector<ExactItem> & items) {
+        size_t goods_count = this->input_goods_.size();
+        items.resize(goods_count);
+        for (size_t i = 0; i < goods_count; i++) {
+            const Goods & goods = this->input_goods_[i];
+            ExactItem & item = items[i];
+            item.min_price = (goods.price - this->fluctuation_).cents;
+            item.max_price = (goods.price + this->fluctuation_).cents;
+            item.min_count = (std::max)(goods.count_range.min, 1);
+            item.max_count = (goods.count_range.max >= item.min_count) ? goods.count_range.max : 0;
+        }
+
+        if (this->has_search_deadline_) {
+            this->exact_solver_.set_deadline(this->search_deadline_);
+            this->mitm_solver_.set_deadline(this->search_deadline_);
+            this->bnb_solver_.set_deadline(this->search_deadline_);
+            this->gcd_solver_.set_deadline(this->search_deadline_);
+            this->greedy_solver_.set_deadline(this->search_deadline_);
+            this->annealing_solver_.set_deadline(this->search_deadline_);
+        }
+        else {
+            this->exact_solver_.clear_deadline();
+            this->mitm_solver_.clear_deadline();
+            this->bnb_solver_.clear_deadline();
+            this->gcd_solver_.clear_deadline();
+            this->greedy_solver_.clear_deadline();
+            this->annealing_solver_.clear_deadline();
+        }
+    }
+
+    bool exact_search_price_and_amount() {
+        this->reset_best_answer();
+
+        std::vector<ExactItem> items;
+        this->make_exact_items(items);
+
+        std::vector<ExactChoice> answer;
+        int status = this->exact_solver_.solve(this->total_amount_.cents, items, answer);
+        return record_exact_answer(status, answer);
+    }
+
+    bool mitm_search_price_and_amount() {
+        this->reset_best_answer();
+
+        std::vector<ExactItem> items;
+        this->make_exact_items(items);
+
+        std::vector<ExactChoice> answer;
+        int status = this->mitm_solver_.solve(this->total_amount_.cents, items, answer);
+        return record_exact_answer(status, answer);
+    }
+
+    bool bnb_search_price_and_amount() {
+        this->reset_best_answer();
+
+        std::vector<ExactItem> items;
+        this->make_exact_items(items);
+
+        std::vector<ExactChoice> answer;
+        int status = this->bnb_solver_.solve(this->total_amount_.cents, items, answer);
+        if (this->verbose_) {
+            printf(" bnb_nodes = %llu\n\n", (unsigned long long)this->bnb_solver_.node_count());
+        }
+        return record_exact_answer(status, answer);
+    }
+
+    //
+    // The closed-form fast path of 2 or 3 goods (see GcdSolver), it's tried before any solver.
+    // Returns the ExactStatus, the answer is the best answer if it's ExactStatus::Found.
+    //
+    int gcd_search_price_and_amount() {
+        this->reset_best_answer();
+
+        std::vector<ExactItem> items;
+        this->make_exact_items(items);
+
+        std::vector<ExactChoice> answer;
+        int status = this->gcd_solver_.solve(this->total_amount_.cents, items, answer);
+        if (status == ExactStatus::Found)
+            record_exact_answer(status, answer);
+        return status;
+    }
+
+    //
+    // The greedy fill and exact correction of the invoices of many goods (see GreedyFillSolver),
+    // it's tried before any solver too. Returns the ExactStatus, it's never Infeasible.
+    //
+    int greedy_search_price_and_amount() {
+        this->reset_best_answer();
+
+        std::vector<ExactItem> items;
+        this->make_exact_items(items);
+
+        std::vector<ExactChoice> answer;
+        int status = this->greedy_solver_.solve(this->total_amount_.cents, items, answer);
+        if (this->verbose_) {
+            printf(" greedy_corrections = %u\n\n", (uint32_t)this->greedy_solver_.correction_count());
+        }
+        if (status == ExactStatus::Found)
+            record_exact_answer(status, answer);
+        return status;
+    }
+
+    //
+    // Races all the searches on their own threads (see PortfolioSolver): thread_count restart
+    // workers (0 is the cores left by the others), the fast search and the exact solvers.
+    // The first perfect answer cancels the others, and so does a proof that there is none,
+    // unless a target error is set (the random searches look for an approximate answer).
+    //
+    bool portfolio_search_price_and_amount(size_t thread_count) {
+        this->reset_best_answer();
+
+        std::vector<ExactItem> items;
+        this->make_exact_items(items);
+        int64_t target = this->total_amount_.cents;
+        this->exact_solver_.set_cancel_token(&this->cancel_token_);
+        this->mitm_solver_.set_cancel_token(&this->cancel_token_);
+        this->bnb_solver_.set_cancel_token(&this->cancel_token_);
+
+        static const size_t kOtherStrategies = 4;
+        if (thread_count == 0) {
+            size_t cores = (std::max)((size_t)std::thread::hardware_concurrency(), size_t(1));
+            thread_count = (cores > kOtherStrategies + 1) ? (cores - kOtherStrategies) : 1;
+        }
+        size_t max_search_cnt = this->max_search_count();
+        if (max_search_cnt != (std::numeric_limits<size_t>::max)())
+            max_search_cnt = (max_search_cnt + thread_count - 1) / thread_count;
+
+        // Each random search has its own scratch list and its own random stream.
+        std::vector<GoodsList> scratch_lists(thread_count + 1, this->goods_list_);
+        std::vector<RandomGenerator> randoms;
+        randoms.reserve(thread_count + 1);
+        for (size_t i = 0; i < thread_count + 1; i++) {
+            randoms.push_back(this->random_.split());
+        }
+        std::atomic<size_t> search_cnt(0);
+
+        PortfolioSolver portfolio;
+        portfolio.set_cancel_on_infeasible(this->target_error_ == Money(0));
+        portfolio.add("exact", [this, target, &items](CancelToken &) {
+            std::vector<ExactChoice> answer;
+            int status = this->exact_solver_.solve(target, items, answer);
+            if (status == ExactStatus::Found)
+                this->record_exact_answer(status, answer);
+            return status;
+        });
+        portfolio.add("mitm", [this, target, &items](CancelToken &) {
+            std::vector<ExactChoice> answer;
+            int status = this->mitm_solver_.solve(target, items, answer);
+            if (status == ExactStatus::Found)
+                this->record_exact_answer(status, answer);
+            return status;
+        });
+        portfolio.add("bnb", [this, target, &items](CancelToken &) {
+            std::vector<ExactChoice> answer;
+            int status = this->bnb_solver_.solve(target, items, answer);
+            if (status == ExactStatus::Found)
+                this->record_exact_answer(status, answer);
+            return status;
+        });
+        // The random searches stop at the cancel_token_ of the workers, they never prove anything.
+        portfolio.add("fast", [this, thread_count, &randoms, &scratch_lists, &search_cnt](CancelToken &) {
+            search_cnt += this->fast_search_worker(randoms[thread_count], scratch_lists[thread_count],
+                                                   this->max_search_count());
+            return this->random_search_status();
+        });
+        for (size_t i = 0; i < thread_count; i++) {
+            portfolio.add("random", [this, i, max_search_cnt, &randoms, &scratch_lists, &search_cnt](CancelToken &) {
+                CandidateBatch batch;
+                SearchCandidate candidate;
+                search_cnt += this->search_worker(randoms[i], scratch_lists[i], batch, candidate, max_search_cnt);
+                return this->random_search_status();
+            });
+        }
+
+        int status = portfolio.race(this->cancel_token_);
+
+        this->exact_solver_.set_cancel_token(nullptr);
+        this->mitm_solver_.set_cancel_token(nullptr);
+        this->bnb_solver_.set_cancel_token(nullptr);
+
+        if (this->verbose_) {
+            size_t winner = portfolio.winner();
+            printf(" threads = %u, search_cnt = %u, bnb_nodes = %llu, winner = %s\n\n",
+                   (uint32_t)portfolio.size(), (uint32_t)search_cnt.load(),
+                   (unsigned long long)this->bnb_solver_.node_count(),
+                   (winner != PortfolioSolver::kNoWinner) ? portfolio.name(winner) : "none");
+        }
+        if (status == ExactStatus::Infeasible && this->min_price_error() != Money(0))
+            return record_exact_answer(status, std::vector<ExactChoice>());
+        return (this->min_price_error() == Money(0));
+    }
+
+    // The ExactStatus of a random search in a portfolio, it's Timeout if it isn't perfect.
+    int random_search_status() const {
+        return ((this->min_price_error() == Money(0)) ? ExactStatus::Found : ExactStatus::Timeout);
+    }
+
+    //
+    // The local search of a near miss (see AnnealingSolver): the best answer of a search which
+    // isn't perfect is moved by a cent of a price or a few counts at a time, rather than drawn
+    // again. Returns true if it's perfect now.
+    //
+    bool anneal_best_answer() {
+        size_t goods_count = this->input_goods_.size();
+        std::vector<ExactItem> items;
+        this->make_exact_items(items);
+
+        std::vector<ExactChoice> start(goods_count);
+        for (size_t i = 0; i < goods_count; i++) {
+            start[i] = ExactChoice(this->best_answer_[i].price.cents, (int64_t)this->best_answer_[i].count);
+        }
+
+        std::vector<ExactChoice> answer;
+        this->annealing_solver_.solve(this->total_amount_.cents, items, start, this->random_, answer);
+        if (this->verbose_) {
+            printf(" anneal_steps = %llu, price_error = %s -> %s\n\n",
+                   (unsigned long long)this->annealing_solver_.step_count(),
+                   Money(this->annealing_solver_.start_error()).to_string().c_str(),
+                   Money(this->annealing_solver_.best_error()).to_string().c_str());
+        }
+        if (answer.size() == goods_count) {
+            GoodsList goods_list(this->input_goods_);
+            for (size_t i = 0; i < goods_count; i++) {
+                goods_list[i].price = Money(answer[i].price);
+                goods_list[i].count = (size_t)answer[i].count;
+            }
+            record_min_price_error(calc_total_amount(goods_list) - this->total_amount_, goods_list);
+        }
+        return (this->min_price_error() == Money(0));
+    }
+
+    // The best answer isn't perfect, and the presolve doesn't rule out a perfect one.
+    bool is_near_miss() const {
+        return (this->has_best_answer() && this->min_price_error() != Money(0)
+                && !this->presolve_.is_infeasible());
+    }
+
+    //
+    // The O(n) feasibility checks of the invoice (see Presolver), before any search. If they
+    // prove that there is no perfect answer, the search is skipped, unless a random search
+    // may still stop at an approximate answer (a target error is set).
+    //
+    bool presolve_rejects(int solver_mode) {
+        std::vector<ExactItem> items;
+        this->make_exact_items(items);
+        this->presolve_ = Presolver::analyze(this->total_amount_.cents, items);
+        if (!this->presolve_.is_infeasible())
+            return false;
+        if (!is_exact_mode(solver_mode) && this->target_error_ != Money(0))
+            return false;
+
+        this->reset_best_answer();
+        if (this->verbose_) {
+            printf(" The presolve proved that there is no answer: %s, the nearest total is %s.\n\n",
+                   this->presolve_.reason_name(), Money(this->presolve_.nearest_total).to_string().c_str());
+        }
+        return true;
+    }
+
+    static bool is_exact_mode(int solver_mode) {
+        return (solver_mode == SolverMode::Exact || solver_mode == SolverMode::MeetInMiddle ||
+                solver_mode == SolverMode::BranchBound);
+    }
+
+    // A proof that there is no perfect answer ends the search, the random searches don't go
+    // on for the closest answer.
+    bool is_settled_by_proof(int solver_mode) const {
+        return (is_exact_mode(solver_mode)
+                || (solver_mode == SolverMode::Portfolio && this->target_error_ == Money(0)));
+    }
+
+    // The answer of the exact solvers is the best answer if status is ExactStatus::Found.
+    bool record_exact_answer(int status, const std::vector<ExactChoice> & answer) {
+        size_t goods_count = this->input_goods_.size();
+        if (status == ExactStatus::Found) {
+            std::lock_guard<std::mutex> lock(this->best_mutex_);
+            this->best_answer_ = this->input_goods_;
+            for (size_t i = 0; i < goods_count; i++) {
+                this->best_answer_[i].price = Money(answer[i].price);
+                this->best_answer_[i].count = (size_t)answer[i].count;
+            }
+            this->min_price_error_.store((calc_total_amount(this->best_answer_) - this->total_amount_).abs().cents);
+            assert(this->min_price_error() == Money(0));
+        }
+        else if (this->verbose_) {
+            if (status == ExactStatus::Infeasible)
+                printf(" The exact search proved that there is no answer.\n\n");
+            else if (status == ExactStatus::Timeout)
+                printf(" The exact search is out of time.\n\n");
+            else
+                printf(" The invoice is too large for the exact search.\n\n");
+        }
+        return (status == ExactStatus::Found);
+    }
+
+    void make_cache_goods(std::vector<CacheGoods> & goods) const {
+        goods.resize(this->input_goods_.size());
+        for (size_t i = 0; i < this->input_goods_.size(); i++) {
+            const Goods & input = this->input_goods_[i];
+            goods[i] = CacheGoods(input.price.cents, input.count_range.min, input.count_range.max);
+        }
+    }
+
+    // A hit is checked by the cache that it sums to the total amount exactly.
+    bool lookup_solution_cache() {
+        if (this->solution_cache_ == nullptr)
+            return false;
+
+        std::vector<CacheGoods> goods;
+        std::vector<ExactChoice> answer;
+        this->make_cache_goods(goods);
+        if (!this->solution_cache_->lookup(this->total_amount_.cents, this->fluctuation_.cents, goods, answer))
+            return false;
+
+        this->reset_best_answer();
+        for (size_t i = 0; i < answer.size(); i++) {
+            this->best_answer_[i].price = Money(answer[i].price);
+            this->best_answer_[i].count = (size_t)answer[i].count;
+        }
+        this->min_price_error_.store(0);
+        if (this->verbose_) {
+            printf(" Found in the solution cache.\n\n");
+        }
+        return true;
+    }
+
+    void store_solution_cache() {
+        if (this->solution_cache_ == nullptr || this->min_price_error() != Money(0))
+            return;
+
+        std::vector<CacheGoods> goods;
+        std::vector<ExactChoice> answer(this->best_answer_.size());
+        this->make_cache_goods(goods);
+        for (size_t i = 0; i < this->best_answer_.size(); i++) {
+            answer[i] = ExactChoice(this->best_answer_[i].price.cents, (int64_t)this->best_answer_[i].count);
+        }
+        this->solution_cache_->store(this->total_amount_.cents, this->fluctuation_.cents, goods, answer);
+    }
+
+public:
+    //
+    // Searches with the given SolverMode and prints nothing (but the statistics if verbose),
+    // returns true if a perfect answer is found. The best answer is get_best_answer().
+    // With a solution cache, a solved problem isn't searched again.
+    //
+    bool search(int solver_mode, size_t thread_count = 1) {
+        this->normalize_prices();
+        this->start_search_deadline();
+        this->stats_.clear();
+        this->improvement_count_.store(0);
+
+        this->from_cache_ = false;
+        if (this->presolve_rejects(solver_mode))
+            return false;
+
+        this->from_cache_ = this->lookup_solution_cache();
+        if (this->from_cache_)
+            return true;
+
+        // The invoices of 2 or 3 goods are solved in closed form first. If it proves that there
+        // is no perfect answer, the random searches still look for the closest one. The
+        // invoices of many goods are tried by the greedy fill first.
+        int fast_status = ExactStatus::TooLarge;
+        if (GcdSolver::is_supported(this->input_goods_.size()))
+            fast_status = gcd_search_price_and_amount();
+        else if (GreedyFillSolver::is_supported(this->input_goods_.size()))
+            fast_status = greedy_search_price_and_amount();
+
+        bool found;
+        if (fast_status == ExactStatus::Found)
+            found = true;
+        else if (fast_status == ExactStatus::Infeasible && this->is_settled_by_proof(solver_mode))
+            found = record_exact_answer(fast_status, std::vector<ExactChoice>());
+        else if (solver_mode == SolverMode::Exact)
+            found = exact_search_price_and_amount();
+        else if (solver_mode == SolverMode::Fast)
+            found = fast_search_price_and_amount();
+        else if (solver_mode == SolverMode::Parallel)
+            found = parallel_search_price_and_amount(thread_count);
+        else if (solver_mode == SolverMode::MeetInMiddle)
+            found = mitm_search_price_and_amount();
+        else if (solver_mode == SolverMode::BranchBound)
+            found = bnb_search_price_and_amount();
+        else if (solver_mode == SolverMode::Portfolio)
+            found = portfolio_search_price_and_amount(thread_count);
+        else
+            found = search_price_and_amount();
+
+        if (!found && this->is_near_miss())
+            found = anneal_best_answer();
+
+        this->stats_.improvements = this->improvement_count_.load();
+        if (found)
+            this->store_solution_cache();
+        return found;
+    }
+
+    // The counters of the last search().
+    const SearchStats & get_search_stats() const {
+        return this->stats_;
+    }
+
+    // The feasibility checks of the last search(), is_infeasible() if it was skipped.
+    const PresolveResult & get_presolve_result() const {
+        return this->presolve_;
+    }
+
+    // The last search() has no answer at all because the presolve proved that there is none.
+    bool is_proved_infeasible() const {
+        return (this->presolve_.is_infeasible() && !this->has_best_answer());
+    }
+
+    // The answer of the last search() is from the solution cache.
+    bool is_from_cache() const {
+        return this->from_cache_;
+    }
+
+    bool has_best_answer() const {
+        return (this->min_price_error_.load() != (std::numeric_limits<int64_t>::max)());
+    }
+
+    const GoodsList & get_best_answer() const {
+        return this->best_answer_;
+    }
+
+    //
+    // A copy of the best answer so far, it may be called by another thread while the
+    // search is running. Returns false if there is no answer yet.
+    //
+    bool get_best_answer_snapshot(GoodsList & answer, Money & price_error) {
+        std::lock_guard<std::mutex> lock(this->best_mutex_);
+        if (!this->has_best_answer())
+            return false;
+        answer = this->best_answer_;
+        price_error = this->min_price_error();
+        return true;
+    }
+
+    Money get_price_error() const {
+        return this->min_price_error();
+    }
+
+    // The total change of the prices of answer from the input prices.
+    Money get_price_deviation(const GoodsList & answer) const {
+        Money deviation(0);
+        for (size_t i = 0; i < answer.size() && i < this->input_goods_.size(); i++) {
+            deviation += (answer[i].price - this->input_goods_[i].price).abs();
+        }
+        return deviation;
+    }
+
+    //
+    // Streams every distinct perfect answer to visit(const GoodsList & answer), until visit
+    // returns false. The answers aren't kept, so the memory is the same for any number of
+    // them. Returns the number of answers visited, they are only a part of all at the time
+    // limit or at cancel(). status (if not nullptr) is ExactStatus::Timeout then, Found if
+    // the enumeration is done (even with no answer), or why the exact stages can't be built.
+    //
+    template <typename Visitor>
+    size_t enumerate_answers(Visitor && visit, int * status = nullptr) {
+        this->normalize_prices();
+        this->start_search_deadline();
+        this->cancel_token_.reset();
+
+        std::vector<ExactItem> items;
+        this->make_exact_items(items);
+        this->exact_solver_.set_cancel_token(&this->cancel_token_);
+        int exact_status = this->exact_solver_.begin_enumerate(this->total_amount_.cents, items);
+        if (exact_status != ExactStatus::Found) {
+            this->exact_solver_.set_cancel_token(nullptr);
+            if (status != nullptr)
+                *status = exact_status;
+            return 0;
+        }
+
+        GoodsList answer(this->input_goods_);
+        std::vector<ExactChoice> choices;
+        size_t answer_count = 0;
+        while (this->exact_solver_.next_answer(choices)) {
+            for (size_t i = 0; i < choices.size(); i++) {
+                answer[i].price = Money(choices[i].price);
+                answer[i].count = (size_t)choices[i].count;
+            }
+            answer_count++;
+            if (!visit((const GoodsList &)answer))
+                break;
+        }
+        this->exact_solver_.set_cancel_token(nullptr);
+        if (status != nullptr)
+            *status = (this->exact_solver_.timed_out() ? ExactStatus::Timeout : ExactStatus::Found);
+        return answer_count;
+    }
+
+    //
+    // The top_k perfect answers which are the closest to the input prices (the smallest
+    // get_price_deviation() first). Only top_k answers are kept while all are enumerated.
+    // At the time limit (status is ExactStatus::Timeout) they are the top_k of the answers
+    // enumerated so far.
+    //
+    size_t top_answers(size_t top_k, std::vector<GoodsList> & answers, int * status = nullptr) {
+        answers.clear();
+        if (status != nullptr)
+            *status = ExactStatus::Found;
+        if (top_k == 0)
+            return 0;
+
+        // A max-heap on the deviation, the worst kept answer is on the top.
+        typedef std::pair<int64_t, GoodsList> Ranked;
+        auto is_closer = [](const Ranked & lhs, const Ranked & rhs) {
+            return (lhs.first < rhs.first);
+        };
+        std::vector<Ranked> heap;
+        heap.reserve(top_k);
+        this->enumerate_answers([&](const GoodsList & answer) {
+            int64_t deviation = this->get_price_deviation(answer).cents;
+            if (heap.size() < top_k) {
+                heap.push_back(Ranked(deviation, answer));
+                std::push_heap(heap.begin(), heap.end(), is_closer);
+            }
+            else if (deviation < heap.front().first) {
+                std::pop_heap(heap.begin(), heap.end(), is_closer);
+                heap.back().first = deviation;
+                std::copy(answer.begin(), answer.end(), heap.back().second.begin());
+                std::push_heap(heap.begin(), heap.end(), is_closer);
+            }
+            return true;
+        }, status);
+
+        std::sort_heap(heap.begin(), heap.end(), is_closer);
+        answers.reserve(heap.size());
+        for (size_t i = 0; i < heap.size(); i++) {
+            answers.push_back(std::move(heap[i].second));
+        }
+        return answers.size();
+    }
+};
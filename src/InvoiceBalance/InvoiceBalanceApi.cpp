@@ -0,0 +1,292 @@
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <new>
+#include <chrono>
+#include <exception>
+
+#include "InvoiceBalanceApi.h"
+#include "InvoiceBalance.h"
+
+//
+// The C interface of libinvoicebalance over the InvoiceBalance class, see InvoiceBalanceApi.h.
+// No exception gets out of these functions, and nothing is printed (the searches are quiet).
+//
+
+// The invoice_result of version 1 ends at infeasible_reason.
+static const size_t kResultSizeV1 = offsetof(invoice_result, infeasible_reason);
+
+struct invoice_solver_handle {
+    InvoiceBalance  balance;
+    SolutionCache   solution_cache;
+
+    invoice_solver_handle() {
+        this->balance.set_verbose(false);
+    }
+};
+
+static bool to_solver_mode(int32_t solver, int & solver_mode)
+{
+    switch (solver) {
+    case INVOICE_SOLVER_RANDOM:
+        solver_mode = SolverMode::Random;
+        return true;
+    case INVOICE_SOLVER_FAST:
+        solver_mode = SolverMode::Fast;
+        return true;
+    case INVOICE_SOLVER_EXACT:
+        solver_mode = SolverMode::Exact;
+        return true;
+    case INVOICE_SOLVER_PARALLEL:
+        solver_mode = SolverMode::Parallel;
+        return true;
+    case INVOICE_SOLVER_MITM:
+        solver_mode = SolverMode::MeetInMiddle;
+        return true;
+    case INVOICE_SOLVER_BNB:
+        solver_mode = SolverMode::BranchBound;
+        return true;
+    case INVOICE_SOLVER_PORTFOLIO:
+        solver_mode = SolverMode::Portfolio;
+        return true;
+    default:
+        return false;
+    }
+}
+
+static void copy_stats(const SearchStats & stats, invoice_stats & out)
+{
+    out.restarts = stats.restarts;
+    out.rejected_restarts = stats.rejected_restarts;
+    out.padding_out_of_range = stats.padding_out_of_range;
+    out.improvements = stats.improvements;
+    out.price_draw_ns = stats.price_draw_ns;
+    out.count_draw_ns = stats.count_draw_ns;
+    out.adjust_ns = stats.adjust_ns;
+}
+
+static void clear_result(invoice_result * result)
+{
+    result->answer_count = 0;
+    result->actual_total = 0;
+    result->price_error = 0;
+    result->seed = 0;
+    result->from_cache = 0;
+    result->reserved = 0;
+    memset(&result->stats, 0, sizeof(result->stats));
+    if (result->struct_size >= sizeof(invoice_result)) {
+        result->infeasible_reason = INVOICE_INFEASIBLE_NONE;
+        result->reserved2 = 0;
+        result->nearest_total = 0;
+    }
+}
+
+static int32_t to_infeasible_reason(int reason)
+{
+    switch (reason) {
+    case PresolveReason::NoGoods:       return INVOICE_INFEASIBLE_NO_GOODS;
+    case PresolveReason::NoPrice:       return INVOICE_INFEASIBLE_NO_PRICE;
+    case PresolveReason::BelowMinimum:  return INVOICE_INFEASIBLE_BELOW_MINIMUM;
+    case PresolveReason::AboveMaximum:  return INVOICE_INFEASIBLE_ABOVE_MAXIMUM;
+    case PresolveReason::Residue:       return INVOICE_INFEASIBLE_RESIDUE;
+    default:                            return INVOICE_INFEASIBLE_NONE;
+    }
+}
+
+static int32_t solve_problem(invoice_solver_handle * solver, const invoice_problem * problem,
+                             invoice_result * result)
+{
+    int solver_mode;
+    if (problem->struct_size < sizeof(invoice_problem) || !to_solver_mode(problem->solver, solver_mode))
+        return INVOICE_STATUS_INVALID_ARGUMENT;
+    if (problem->goods_count == 0 || problem->goods == nullptr || problem->total_amount <= 0)
+        return INVOICE_STATUS_INVALID_ARGUMENT;
+    for (size_t i = 0; i < problem->goods_count; i++) {
+        const invoice_goods & goods = problem->goods[i];
+        if (goods.price <= 0 || goods.min_count < 0 || goods.max_count < 0)
+            return INVOICE_STATUS_INVALID_ARGUMENT;
+    }
+    if (result->answer_capacity < problem->goods_count || result->answer == nullptr)
+        return INVOICE_STATUS_BUFFER_TOO_SMALL;
+
+    InvoiceBalance::GoodsList goods_list(problem->goods_count);
+    for (size_t i = 0; i < problem->goods_count; i++) {
+        const invoice_goods & src = problem->goods[i];
+        goods_list[i].price = Money(src.price);
+        goods_list[i].count = 0;
+        goods_list[i].count_range = CountRange((src.min_count > 0) ? src.min_count : 1, src.max_count);
+    }
+
+    uint64_t seed = problem->seed;
+    if (seed == 0) {
+        seed = (uint64_t)std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    }
+
+    InvoiceBalance & balance = solver->balance;
+    balance.set_total_amount(Money(problem->total_amount), Money(problem->fluctuation));
+    balance.set_price_and_count(goods_list);
+    balance.set_random_seed(seed);
+    balance.set_collect_timing(problem->collect_timing != 0);
+    balance.set_time_limit(problem->time_limit_ms);
+    balance.set_target_error(Money(problem->target_error));
+
+    bool found = balance.search(solver_mode, problem->thread_count);
+
+    const PresolveResult & presolve = balance.get_presolve_result();
+    if (result->struct_size >= sizeof(invoice_result)) {
+        result->infeasible_reason = to_infeasible_reason(presolve.reason);
+        result->nearest_total = presolve.nearest_total;
+    }
+
+    result->seed = seed;
+    result->from_cache = balance.is_from_cache() ? 1 : 0;
+    copy_stats(balance.get_search_stats(), result->stats);
+    if (balance.has_best_answer()) {
+        const InvoiceBalance::GoodsList & answer = balance.get_best_answer();
+        Money actual_total(0);
+        for (size_t i = 0; i < answer.size(); i++) {
+            result->answer[i].price = answer[i].price.cents;
+            result->answer[i].count = (int64_t)answer[i].count;
+            actual_total += answer[i].total_money();
+        }
+        result->answer_count = answer.size();
+        result->actual_total = actual_total.cents;
+        result->price_error = balance.get_price_error().cents;
+    }
+    if (found)
+        return INVOICE_STATUS_FOUND;
+    else if (balance.is_proved_infeasible())
+        return INVOICE_STATUS_INFEASIBLE;
+    else
+        return INVOICE_STATUS_NOT_FOUND;
+}
+
+extern "C" {
+
+uint32_t invoice_balance_version(void)
+{
+    return INVOICE_BALANCE_API_VERSION;
+}
+
+void invoice_problem_init(invoice_problem * problem)
+{
+    memset(problem, 0, sizeof(invoice_problem));
+    problem->struct_size = (uint32_t)sizeof(invoice_problem);
+    problem->solver = INVOICE_SOLVER_RANDOM;
+}
+
+void invoice_result_init(invoice_result * result, invoice_answer_goods * answer, size_t answer_capacity)
+{
+    memset(result, 0, sizeof(invoice_result));
+    result->struct_size = (uint32_t)sizeof(invoice_result);
+    result->status = INVOICE_STATUS_NOT_FOUND;
+    result->answer = answer;
+    result->answer_capacity = answer_capacity;
+}
+
+const char * invoice_status_string(int32_t status)
+{
+    switch (status) {
+    case INVOICE_STATUS_FOUND:
+        return "found";
+    case INVOICE_STATUS_NOT_FOUND:
+        return "not_found";
+    case INVOICE_STATUS_INFEASIBLE:
+        return "infeasible";
+    case INVOICE_STATUS_INVALID_ARGUMENT:
+        return "invalid_argument";
+    case INVOICE_STATUS_BUFFER_TOO_SMALL:
+        return "buffer_too_small";
+    case INVOICE_STATUS_CACHE_ERROR:
+        return "cache_error";
+    case INVOICE_STATUS_INTERNAL_ERROR:
+        return "internal_error";
+    default:
+        return "unknown";
+    }
+}
+
+const char * invoice_infeasible_reason_string(int32_t reason)
+{
+    switch (reason) {
+    case INVOICE_INFEASIBLE_NONE:
+        return "feasible";
+    case INVOICE_INFEASIBLE_NO_GOODS:
+        return "no_goods";
+    case INVOICE_INFEASIBLE_NO_PRICE:
+        return "no_price";
+    case INVOICE_INFEASIBLE_BELOW_MINIMUM:
+        return "below_minimum";
+    case INVOICE_INFEASIBLE_ABOVE_MAXIMUM:
+        return "above_maximum";
+    case INVOICE_INFEASIBLE_RESIDUE:
+        return "residue";
+    default:
+        return "unknown";
+    }
+}
+
+invoice_solver_handle * invoice_solver_create(void)
+{
+    return new (std::nothrow) invoice_solver_handle;
+}
+
+void invoice_solver_destroy(invoice_solver_handle * solver)
+{
+    delete solver;
+}
+
+int32_t invoice_solver_open_cache(invoice_solver_handle * solver, const char * filename)
+{
+    if (solver == nullptr || filename == nullptr)
+        return INVOICE_STATUS_INVALID_ARGUMENT;
+    solver->balance.set_solution_cache(nullptr);
+    solver->solution_cache.close();
+    if (!solver->solution_cache.open(filename))
+        return INVOICE_STATUS_CACHE_ERROR;
+    solver->balance.set_solution_cache(&solver->solution_cache);
+    return INVOICE_STATUS_FOUND;
+}
+
+int32_t invoice_solver_solve(invoice_solver_handle * solver, const invoice_problem * problem,
+                             invoice_result * result)
+{
+    if (result == nullptr || result->struct_size < kResultSizeV1)
+        return INVOICE_STATUS_INVALID_ARGUMENT;
+
+    clear_result(result);
+    if (solver == nullptr || problem == nullptr) {
+        result->status = INVOICE_STATUS_INVALID_ARGUMENT;
+        return result->status;
+    }
+
+    try {
+        result->status = solve_problem(solver, problem, result);
+    }
+    catch (const std::exception &) {
+        clear_result(result);
+        result->status = INVOICE_STATUS_INTERNAL_ERROR;
+    }
+    return result->status;
+}
+
+int32_t invoice_balance_solve(const invoice_problem * problem, invoice_result * result)
+{
+    invoice_solver_handle * solver = invoice_solver_create();
+    if (solver == nullptr) {
+        if (result != nullptr && result->struct_size >= kResultSizeV1) {
+            clear_result(result);
+            result->status = INVOICE_STATUS_INTERNAL_ERROR;
+            return result->status;
+        }
+        return INVOICE_STATUS_INVALID_ARGUMENT;
+    }
+
+    int32_t status = invoice_solver_solve(solver, problem, result);
+    invoice_solver_destroy(solver);
+    return status;
+}
+
+} // extern "C"
@@ -0,0 +1,164 @@
+#ifndef INVOICE_BALANCE_API_H
+#define INVOICE_BALANCE_API_H
+
+//
+// The C interface of libinvoicebalance: a problem in, a result out, nothing is printed.
+//
+// All the amounts are in cents. The structs start with struct_size, which the caller sets
+// with invoice_problem_init() / invoice_result_init(), so the fields added by a later
+// version (always at the end) are left to their defaults for an older caller.
+//
+//     invoice_goods goods[2] = { { 21200, 100, 0 }, { 17250, 100, 200 } };
+//     invoice_answer_goods answer[2];
+//     invoice_problem problem;
+//     invoice_result result;
+//
+//     invoice_problem_init(&problem);
+//     problem.total_amount = 12000000;
+//     problem.fluctuation = 200;
+//     problem.goods = goods;
+//     problem.goods_count = 2;
+//     problem.solver = INVOICE_SOLVER_EXACT;
+//
+//     invoice_result_init(&result, answer, 2);
+//     if (invoice_balance_solve(&problem, &result) == INVOICE_STATUS_FOUND) { ... }
+//
+// A solver handle keeps its buffers (and the solution cache) between the calls, one handle
+// must not be used by two threads at the same time.
+//
+
+#include <stdint.h>
+#include <stddef.h>
+
+#if defined(_WIN32) && defined(INVOICE_BALANCE_SHARED)
+#  if defined(INVOICE_BALANCE_EXPORTS)
+#    define INVOICE_BALANCE_API     __declspec(dllexport)
+#  else
+#    define INVOICE_BALANCE_API     __declspec(dllimport)
+#  endif
+#elif defined(__GNUC__)
+#  define INVOICE_BALANCE_API       __attribute__((visibility("default")))
+#else
+#  define INVOICE_BALANCE_API
+#endif
+
+#define INVOICE_BALANCE_API_VERSION     3
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum invoice_solver {
+    INVOICE_SOLVER_RANDOM       = 0,
+    INVOICE_SOLVER_FAST         = 1,
+    INVOICE_SOLVER_EXACT        = 2,
+    INVOICE_SOLVER_PARALLEL     = 3,
+    INVOICE_SOLVER_MITM         = 4,
+    INVOICE_SOLVER_BNB          = 5,
+    INVOICE_SOLVER_PORTFOLIO    = 6     // version 3, races all the others on their own threads
+};
+
+enum invoice_status {
+    INVOICE_STATUS_FOUND            = 0,    // a perfect answer
+    INVOICE_STATUS_NOT_FOUND        = 1,    // the best answer (if any) has a price error
+    INVOICE_STATUS_INFEASIBLE       = 2,    // proved by the presolve, see infeasible_reason
+    INVOICE_STATUS_INVALID_ARGUMENT = -1,
+    INVOICE_STATUS_BUFFER_TOO_SMALL = -2,   // answer_capacity < goods_count, nothing is solved
+    INVOICE_STATUS_CACHE_ERROR      = -3,
+    INVOICE_STATUS_INTERNAL_ERROR   = -4    // out of memory, or a failed thread
+};
+
+// Why the presolve proved that there is no perfect answer (version 2).
+enum invoice_infeasible_reason {
+    INVOICE_INFEASIBLE_NONE             = 0,
+    INVOICE_INFEASIBLE_NO_GOODS         = 1,
+    INVOICE_INFEASIBLE_NO_PRICE         = 2,    // a price band has no positive price
+    INVOICE_INFEASIBLE_BELOW_MINIMUM    = 3,    // below all the goods at their minimum
+    INVOICE_INFEASIBLE_ABOVE_MAXIMUM    = 4,    // above all the goods at their maximum
+    INVOICE_INFEASIBLE_RESIDUE          = 5     // not a multiple of the step of the reachable totals
+};
+
+typedef struct invoice_goods {
+    int64_t     price;
+    int32_t     min_count;
+    int32_t     max_count;      // 0 is unlimited
+} invoice_goods;
+
+typedef struct invoice_answer_goods {
+    int64_t     price;
+    int64_t     count;
+} invoice_answer_goods;
+
+typedef struct invoice_problem {
+    uint32_t                struct_size;
+    int32_t                 solver;         // enum invoice_solver
+    int64_t                 total_amount;
+    int64_t                 fluctuation;
+    const invoice_goods *   goods;
+    size_t                  goods_count;
+    uint32_t                thread_count;   // INVOICE_SOLVER_PARALLEL and PORTFOLIO, 0 is all the cores
+    uint32_t                collect_timing; // non-zero measures the phase times of the stats
+    uint64_t                seed;           // 0 is a new seed, see invoice_result::seed
+    int64_t                 time_limit_ms;  // 0 is no time limit
+    int64_t                 target_error;
+} invoice_problem;
+
+typedef struct invoice_stats {
+    uint64_t    restarts;
+    uint64_t    rejected_restarts;
+    uint64_t    padding_out_of_range;
+    uint64_t    improvements;
+    int64_t     price_draw_ns;
+    int64_t     count_draw_ns;
+    int64_t     adjust_ns;
+} invoice_stats;
+
+typedef struct invoice_result {
+    uint32_t                struct_size;
+    int32_t                 status;         // enum invoice_status
+    invoice_answer_goods *  answer;         // the caller's buffer, in the order of the goods
+    size_t                  answer_capacity;
+    size_t                  answer_count;   // goods_count if there is an answer, else 0
+    int64_t                 actual_total;
+    int64_t                 price_error;    // |actual_total - total_amount|
+    uint64_t                seed;
+    uint32_t                from_cache;
+    uint32_t                reserved;
+    invoice_stats           stats;
+
+    // Version 2, only written if struct_size covers them.
+    int32_t                 infeasible_reason;  // enum invoice_infeasible_reason
+    uint32_t                reserved2;
+    int64_t                 nearest_total;      // the closest total that passes the presolve
+} invoice_result;
+
+typedef struct invoice_solver_handle invoice_solver_handle;
+
+// INVOICE_BALANCE_API_VERSION of the library.
+INVOICE_BALANCE_API uint32_t invoice_balance_version(void);
+
+INVOICE_BALANCE_API void invoice_problem_init(invoice_problem * problem);
+INVOICE_BALANCE_API void invoice_result_init(invoice_result * result,
+                                             invoice_answer_goods * answer, size_t answer_capacity);
+
+INVOICE_BALANCE_API const char * invoice_status_string(int32_t status);
+INVOICE_BALANCE_API const char * invoice_infeasible_reason_string(int32_t reason);
+
+INVOICE_BALANCE_API invoice_solver_handle * invoice_solver_create(void);
+INVOICE_BALANCE_API void invoice_solver_destroy(invoice_solver_handle * solver);
+
+// Memory-maps the file of the perfect answers, shared by the later solves of the handle.
+INVOICE_BALANCE_API int32_t invoice_solver_open_cache(invoice_solver_handle * solver, const char * filename);
+
+// Returns result->status.
+INVOICE_BALANCE_API int32_t invoice_solver_solve(invoice_solver_handle * solver,
+                                                 const invoice_problem * problem, invoice_result * result);
+
+// One solve on a temporary handle.
+INVOICE_BALANCE_API int32_t invoice_balance_solve(const invoice_problem * problem, invoice_result * result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // INVOICE_BALANCE_API_H
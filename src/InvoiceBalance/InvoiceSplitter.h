@@ -0,0 +1,333 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "Money.h"
+#include "Random.h"
+#include "InvoiceBalance.h"
+#include "Presolve.h"
+#include "SolutionCache.h"
+
+//
+// The splitting of an order which is over the amount limit of one invoice into N invoices,
+// N = ceil(total / max_invoice_amount), each one balanced exactly on its own:
+//
+//   the total    split evenly, each invoice gets total / N (the first ones a cent more).
+//   the goods    each goods is on min(N, its max count) invoices, and its count range is
+//                split over them, so the counts of all the invoices add up to the count
+//                range of the order, whatever each invoice answers.
+//
+// The invoices are solved concurrently, one InvoiceBalance each. If an invoice has no perfect
+// answer, a part of its total is moved to or from another invoice: to the nearest total that
+// passes its presolve, or else a random amount up to its cheapest price. Both are solved
+// again, for at most kMaxRounds rounds. If the presolve proves that the whole order has no
+// perfect answer, no split has one either, the invoices are solved once for their best answers.
+//
+class InvoiceSplitter
+{
+public:
+    typedef InvoiceBalance::GoodsList   GoodsList;
+
+    static const size_t kMaxRounds = 16;
+
+    struct Invoice {
+        Money               total_amount;
+        std::vector<size_t> goods_index;    // the index of each goods line in the order
+        GoodsList           goods;          // the prices of the order, the count ranges of this invoice
+        GoodsList           answer;         // the best answer, empty if there is none
+        Money               price_error;
+        Money               nearest_total;  // the closest total that passes the presolve
+        bool                found;
+        bool                solved;         // the answer is of total_amount
+
+        Invoice() : total_amount(0), price_error(0), nearest_total(0), found(false), solved(false) {}
+    };
+
+private:
+    Money                   max_invoice_amount_;
+    int                     solver_mode_;
+    size_t                  thread_count_;
+    uint64_t                random_seed_;
+    int64_t                 time_limit_ms_;
+    Money                   target_error_;
+    SolutionCache *         solution_cache_;
+
+    std::vector<Invoice>    invoices_;
+    size_t                  round_count_;
+    PresolveResult          presolve_;
+
+public:
+    InvoiceSplitter() : max_invoice_amount_(0), solver_mode_(SolverMode::Random), thread_count_(0),
+                        random_seed_(0), time_limit_ms_(0), target_error_(0),
+                        solution_cache_(nullptr), round_count_(0) {
+    }
+
+    ~InvoiceSplitter() {
+    }
+
+    // 0 is no limit, the order is one invoice.
+    void set_max_invoice_amount(Money max_invoice_amount) {
+        this->max_invoice_amount_ = max_invoice_amount;
+    }
+
+    // SolverMode::Parallel is searched by one thread per invoice, the invoices are in parallel.
+    void set_solver_mode(int solver_mode) {
+        this->solver_mode_ = solver_mode;
+    }
+
+    // The invoices solved at the same time, 0 is all the cores.
+    void set_thread_count(size_t thread_count) {
+        this->thread_count_ = thread_count;
+    }
+
+    // The same seed replays the same split, whatever the number of threads is.
+    void set_random_seed(uint64_t seed) {
+        this->random_seed_ = seed;
+    }
+
+    // The time budget of each search of an invoice.
+    void set_time_limit(int64_t time_limit_ms) {
+        this->time_limit_ms_ = time_limit_ms;
+    }
+
+    void set_target_error(Money target_error) {
+        this->target_error_ = target_error;
+    }
+
+    void set_solution_cache(SolutionCache * solution_cache) {
+        this->solution_cache_ = solution_cache;
+    }
+
+    const std::vector<Invoice> & invoices() const {
+        return this->invoices_;
+    }
+
+    // The rounds of the last solve().
+    size_t round_count() const {
+        return this->round_count_;
+    }
+
+    // The presolve of the whole order of the last solve().
+    const PresolveResult & get_presolve_result() const {
+        return this->presolve_;
+    }
+
+    // The invoices that total_amount needs under max_invoice_amount (0 is no limit).
+    static size_t invoice_count(Money total_amount, Money max_invoice_amount) {
+        if (max_invoice_amount <= Money(0) || total_amount <= max_invoice_amount)
+            return 1;
+        return (size_t)((total_amount.cents + max_invoice_amount.cents - 1) / max_invoice_amount.cents);
+    }
+
+    //
+    // Splits the order and solves all the invoices, returns true if every one of them has
+    // a perfect answer. The invoices and their best answers are invoices().
+    //
+    bool solve(Money total_amount, Money fluctuation, const GoodsList & goods) {
+        this->invoices_.clear();
+        this->round_count_ = 0;
+        this->presolve_ = PresolveResult();
+        if (goods.empty() || total_amount <= Money(0))
+            return false;
+
+        std::vector<ExactItem> items(goods.size());
+        for (size_t i = 0; i < goods.size(); i++) {
+            items[i].min_price = (goods[i].price - fluctuation).cents;
+            items[i].max_price = (goods[i].price + fluctuation).cents;
+            items[i].min_count = (std::max)(goods[i].count_range.min, 1);
+            items[i].max_count = (goods[i].count_range.max >= items[i].min_count) ? goods[i].count_range.max : 0;
+        }
+        this->presolve_ = Presolver::analyze(total_amount.cents, items);
+
+        size_t n = invoice_count(total_amount, this->max_invoice_amount_);
+        this->split_total(total_amount, n);
+        this->split_goods(goods, n);
+
+        RandomGenerator random(this->random_seed_);
+        bool all_found = false;
+        for (size_t round = 0; round < kMaxRounds; round++) {
+            this->solve_pending(fluctuation, round);
+            this->round_count_++;
+            all_found = this->is_all_found();
+            if (all_found || this->presolve_.is_infeasible() || !this->rebalance(random))
+                break;
+        }
+        return all_found;
+    }
+
+private:
+    void split_total(Money total_amount, size_t n) {
+        this->invoices_.resize(n);
+        int64_t share = total_amount.cents / (int64_t)n;
+        int64_t extra = total_amount.cents % (int64_t)n;
+        for (size_t k = 0; k < n; k++) {
+            this->invoices_[k].total_amount = Money(share + (((int64_t)k < extra) ? 1 : 0));
+        }
+    }
+
+    //
+    // Goods i is on the invoices i, i + 1, ... (mod n), so the invoices have about the same
+    // number of goods. Each invoice gets its part of the min and the max count, the larger
+    // parts to the same invoices, so the min part is never above the max part.
+    //
+    void split_goods(const GoodsList & goods, size_t n) {
+        for (size_t i = 0; i < goods.size(); i++) {
+            const CountRange & count_range = goods[i].count_range;
+            int64_t min_count = (std::max)(count_range.min, 1);
+            bool has_max = (count_range.max >= min_count);
+            int64_t max_count = count_range.max;
+            size_t m = has_max ? (size_t)(std::min)((int64_t)n, max_count) : n;
+
+            for (size_t t = 0; t < m; t++) {
+                Invoice & invoice = this->invoices_[(i + t) % n];
+                Goods part = goods[i];
+                part.count = 0;
+                int64_t min_part = min_count / (int64_t)m + (((int64_t)t < min_count % (int64_t)m) ? 1 : 0);
+                part.count_range.min = (int)(std::max)(min_part, int64_t(1));
+                if (has_max)
+                    part.count_range.max = (int)(max_count / (int64_t)m + (((int64_t)t < max_count % (int64_t)m) ? 1 : 0));
+                else
+                    part.count_range.max = 0;
+                invoice.goods_index.push_back(i);
+                invoice.goods.push_back(part);
+            }
+        }
+    }
+
+    bool is_all_found() const {
+        for (size_t k = 0; k < this->invoices_.size(); k++) {
+            if (!this->invoices_[k].found)
+                return false;
+        }
+        return true;
+    }
+
+    // Solves the invoices which aren't solved, thread_count_ of them at a time.
+    void solve_pending(Money fluctuation, size_t round) {
+        std::vector<size_t> pending;
+        for (size_t k = 0; k < this->invoices_.size(); k++) {
+            if (!this->invoices_[k].solved)
+                pending.push_back(k);
+        }
+
+        size_t thread_count = this->thread_count_;
+        if (thread_count == 0) {
+            thread_count = (std::max)((size_t)std::thread::hardware_concurrency(), size_t(1));
+        }
+        thread_count = (std::min)(thread_count, pending.size());
+
+        std::atomic<size_t> next(0);
+        std::vector<std::thread> workers;
+        workers.reserve(thread_count);
+        for (size_t i = 0; i < thread_count; i++) {
+            workers.push_back(std::thread([this, fluctuation, round, &pending, &next]() {
+                for (;;) {
+                    size_t p = next.fetch_add(1);
+                    if (p >= pending.size())
+                        break;
+                    this->solve_invoice(pending[p], fluctuation, round);
+                }
+            }));
+        }
+        for (size_t i = 0; i < thread_count; i++) {
+            workers[i].join();
+        }
+    }
+
+    void solve_invoice(size_t k, Money fluctuation, size_t round) {
+        Invoice & invoice = this->invoices_[k];
+        InvoiceBalance balance(invoice.total_amount, fluctuation);
+        balance.set_verbose(false);
+        balance.set_solution_cache(this->solution_cache_);
+        balance.set_time_limit(this->time_limit_ms_);
+        balance.set_target_error(this->target_error_);
+        balance.set_price_and_count(invoice.goods);
+        balance.set_random_seed(this->random_seed_ + round * this->invoices_.size() + k + 1);
+
+        // The invoices are solved by a pool already, a parallel (or portfolio) search of its own
+        // in every worker would start more threads than the cores.
+        int solver_mode = this->solver_mode_;
+        if (solver_mode == SolverMode::Parallel || solver_mode == SolverMode::Portfolio)
+            solver_mode = SolverMode::Random;
+        invoice.found = balance.search(solver_mode);
+        invoice.solved = true;
+
+        const PresolveResult & presolve = balance.get_presolve_result();
+        invoice.nearest_total = (presolve.is_infeasible() && presolve.nearest_total > 0) ? Money(presolve.nearest_total) : invoice.total_amount;
+        if (balance.has_best_answer()) {
+            invoice.answer = balance.get_best_answer();
+            invoice.price_error = balance.get_price_error();
+        }
+        else {
+            invoice.answer.clear();
+            invoice.price_error = Money(0);
+        }
+    }
+
+    //
+    // Moves a part of the total of each invoice without a perfect answer to or from another
+    // invoice, both are solved again. The other one is an invoice without a perfect answer
+    // too if there is one, their misses often cancel out (their residues add up to that of
+    // the order), else a random one. Returns false if nothing can be moved.
+    //
+    bool rebalance(RandomGenerator & random) {
+        size_t n = this->invoices_.size();
+        if (n < 2)
+            return false;
+
+        bool moved = false;
+        for (size_t k = 0; k < n; k++) {
+            Invoice & invoice = this->invoices_[k];
+            if (invoice.found || !invoice.solved || invoice.goods.empty())
+                continue;
+
+            int64_t delta = (invoice.nearest_total - invoice.total_amount).cents;
+            if (delta == 0) {
+                int64_t min_price = invoice.goods[0].price.cents;
+                for (size_t i = 1; i < invoice.goods.size(); i++) {
+                    min_price = (std::min)(min_price, invoice.goods[i].price.cents);
+                }
+                delta = random.next_random_i64(1, (std::max)(min_price, int64_t(1)));
+                if (random.next_random32() & 1)
+                    delta = -delta;
+            }
+
+            size_t j = n;
+            for (size_t t = 1; t < n && j == n; t++) {
+                size_t other = (k + t) % n;
+                if (!this->invoices_[other].found && this->invoices_[other].solved && this->can_move(k, other, delta))
+                    j = other;
+            }
+            if (j == n) {
+                j = (k + 1 + (size_t)random.next_random_64(0, n - 2)) % n;
+                if (!this->can_move(k, j, delta)) {
+                    delta = -delta;
+                    if (!this->can_move(k, j, delta))
+                        continue;
+                }
+            }
+            invoice.total_amount += Money(delta);
+            this->invoices_[j].total_amount -= Money(delta);
+            invoice.solved = false;
+            this->invoices_[j].solved = false;
+            moved = true;
+        }
+        return moved;
+    }
+
+    // Invoice k gets delta and invoice j gives it, both stay in (0, max_invoice_amount_].
+    bool can_move(size_t k, size_t j, int64_t delta) const {
+        int64_t total_k = this->invoices_[k].total_amount.cents + delta;
+        int64_t total_j = this->invoices_[j].total_amount.cents - delta;
+        int64_t max_amount = this->max_invoice_amount_.cents;
+        return (total_k > 0 && total_j > 0 && total_k <= max_amount && total_j <= max_amount);
+    }
+};
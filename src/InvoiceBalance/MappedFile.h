@@ -0,0 +1,140 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <cstdint>
+#include <cstddef>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+//
+// A read-only memory mapping of a whole file, the pages are read by the OS on first touch
+// and nothing is copied. An empty file is open with size() 0 and data() nullptr.
+//
+class MappedFile
+{
+private:
+    const char *    data_;
+    size_t          size_;
+#if defined(_WIN32)
+    HANDLE          file_handle_;
+    HANDLE          mapping_handle_;
+#else
+    int             file_fd_;
+#endif
+    bool            is_open_;
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile & operator = (const MappedFile &) = delete;
+
+public:
+    MappedFile() : data_(nullptr), size_(0),
+#if defined(_WIN32)
+                   file_handle_(INVALID_HANDLE_VALUE), mapping_handle_(NULL),
+#else
+                   file_fd_(-1),
+#endif
+                   is_open_(false) {
+    }
+
+    ~MappedFile() {
+        this->close();
+    }
+
+    const char * data() const { return this->data_; }
+    size_t size() const { return this->size_; }
+    bool is_open() const { return this->is_open_; }
+
+    //
+    // Returns 0 if it's mapped, -2 if the file can't be opened, -3 if it can't be mapped.
+    //
+#if defined(_WIN32)
+    int open(const char * path) {
+        this->close();
+        this->file_handle_ = ::CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                           NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (this->file_handle_ == INVALID_HANDLE_VALUE)
+            return -2;
+        LARGE_INTEGER file_size;
+        if (!::GetFileSizeEx(this->file_handle_, &file_size) || (uint64_t)file_size.QuadPart > (uint64_t)SIZE_MAX) {
+            this->close();
+            return -3;
+        }
+        this->is_open_ = true;
+        if (file_size.QuadPart == 0)
+            return 0;
+
+        this->mapping_handle_ = ::CreateFileMappingA(this->file_handle_, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (this->mapping_handle_ != NULL) {
+            void * view = ::MapViewOfFile(this->mapping_handle_, FILE_MAP_READ, 0, 0, 0);
+            if (view != NULL) {
+                this->data_ = (const char *)view;
+                this->size_ = (size_t)file_size.QuadPart;
+                return 0;
+            }
+        }
+        this->close();
+        return -3;
+    }
+
+    void close() {
+        if (this->data_ != nullptr)
+            ::UnmapViewOfFile(this->data_);
+        if (this->mapping_handle_ != NULL)
+            ::CloseHandle(this->mapping_handle_);
+        if (this->file_handle_ != INVALID_HANDLE_VALUE)
+            ::CloseHandle(this->file_handle_);
+        this->mapping_handle_ = NULL;
+        this->file_handle_ = INVALID_HANDLE_VALUE;
+        this->data_ = nullptr;
+        this->size_ = 0;
+        this->is_open_ = false;
+    }
+#else
+    int open(const char * path) {
+        this->close();
+        this->file_fd_ = ::open(path, O_RDONLY);
+        if (this->file_fd_ < 0)
+            return -2;
+        struct stat st;
+        if (::fstat(this->file_fd_, &st) != 0 || !S_ISREG(st.st_mode)) {
+            this->close();
+            return -3;
+        }
+        this->is_open_ = true;
+        if (st.st_size == 0)
+            return 0;
+
+        void * view = ::mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, this->file_fd_, 0);
+        if (view == MAP_FAILED) {
+            this->close();
+            return -3;
+        }
+        this->data_ = (const char *)view;
+        this->size_ = (size_t)st.st_size;
+        return 0;
+    }
+
+    void close() {
+        if (this->data_ != nullptr)
+            ::munmap((void *)this->data_, this->size_);
+        if (this->file_fd_ >= 0)
+            ::close(this->file_fd_);
+        this->file_fd_ = -1;
+        this->data_ = nullptr;
+        this->size_ = 0;
+        this->is_open_ = false;
+    }
+#endif // _WIN32
+};
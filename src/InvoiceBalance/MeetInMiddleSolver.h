@@ -0,0 +1,186 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+#include <assert.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <thread>
+
+#include "SumBitSet.h"
+#include "ExactSolver.h"
+
+//
+// Meet-in-the-middle solver of the same problem as ExactSolver (ExactItem in, ExactChoice
+// out, ExactStatus back), for the invoices with many goods lines.
+//
+// The goods are split into two halves of about the same number of choices, and each half
+// builds its own reachable-sum stages (the same bitsets as ExactSolver), clipped to the
+// sums that the other half can complete to the target. The halves are independent, so
+// they are built on two threads, each with its own scratch bitset. The last stages
+// of the two halves are joined by testing every left sum x against target - x on the
+// right, then both halves are traced back to their (count, price) choices.
+//
+// The partial sums are bitsets rather than sorted or hashed tables: with the count ranges
+// and the price bands of the invoices, the sums of a half are dense in their window after
+// a few goods, where a table of sums is larger and slower than one bit per cent.
+//
+class MeetInMiddleSolver : public ExactSolver
+{
+private:
+    struct Half {
+        std::vector<size_t>     items;      // the indexes in items_
+        std::vector<SumBitSet>  stages;     // stages[k]: the sums of the half's items[0..k]
+        SumBitSet               scratch;
+        int64_t                 min_sum;
+        int64_t                 max_sum;
+        int                     status;
+
+        Half() : min_sum(0), max_sum(0), status(ExactStatus::Found) {}
+    };
+
+    Half    halves_[2];
+
+public:
+    MeetInMiddleSolver() {
+    }
+
+    ~MeetInMiddleSolver() {
+    }
+
+    int solve(int64_t target, const std::vector<ExactItem> & exact_items,
+              std::vector<ExactChoice> & answer) {
+        answer.clear();
+        this->target_ = target;
+        if (exact_items.empty() || target <= 0)
+            return ExactStatus::Infeasible;
+
+        if (!this->prepare_items(exact_items))
+            return ExactStatus::Infeasible;
+        this->split_items();
+
+        Half & left = this->halves_[0];
+        Half & right = this->halves_[1];
+        if (target < left.min_sum + right.min_sum || target > left.max_sum + right.max_sum)
+            return ExactStatus::Infeasible;
+
+        // The right half on its own thread, the memory limit is shared evenly.
+        std::thread right_builder([this, target]() {
+            Half & left = this->halves_[0];
+            this->halves_[1].status = this->build_half(this->halves_[1], target - left.max_sum,
+                                                       target - left.min_sum);
+        });
+        left.status = this->build_half(left, target - right.max_sum, target - right.min_sum);
+        right_builder.join();
+        if (left.status != ExactStatus::Found)
+            return left.status;
+        if (right.status != ExactStatus::Found)
+            return right.status;
+
+        const SumBitSet & left_sums = this->last_stage(left);
+        const SumBitSet & right_sums = this->last_stage(right);
+        int64_t first = (std::max)(left_sums.first(), target - right_sums.last());
+        int64_t last = (std::min)(left_sums.last(), target - right_sums.first());
+        for (int64_t sum = first; sum <= last; sum++) {
+            if (left_sums.test(sum) && right_sums.test(target - sum)) {
+                answer.resize(exact_items.size());
+                this->trace_answer(left, sum, answer);
+                this->trace_answer(right, target - sum, answer);
+                return ExactStatus::Found;
+            }
+            if ((sum & 0xFFFFF) == 0 && this->is_timeout())
+                return ExactStatus::Timeout;
+        }
+        return ExactStatus::Infeasible;
+    }
+
+private:
+    //
+    // Greedy balance of the search space: the goods with the most choices first, each one to
+    // the half with the smaller product of choices (compared in log2).
+    //
+    void split_items() {
+        double weights[2] = { 0.0, 0.0 };
+        for (size_t h = 0; h < 2; h++) {
+            Half & half = this->halves_[h];
+            half.items.clear();
+            half.min_sum = 0;
+            half.max_sum = 0;
+        }
+        // prepare_items() sorted the items by their choices, the fewest first.
+        for (ptrdiff_t i = (ptrdiff_t)this->items_.size() - 1; i >= 0; i--) {
+            const Item & item = this->items_[i];
+            size_t h = (weights[0] <= weights[1]) ? 0 : 1;
+            Half & half = this->halves_[h];
+            half.items.push_back((size_t)i);
+            half.min_sum += item.min_count * item.min_price;
+            half.max_sum += item.max_count * item.max_price;
+            weights[h] += log2((double)item.choices());
+        }
+    }
+
+    const SumBitSet & stage_before(const Half & half, size_t k) const {
+        return ((k == 0) ? this->origin_ : half.stages[k - 1]);
+    }
+
+    const SumBitSet & last_stage(const Half & half) const {
+        return this->stage_before(half, half.items.size());
+    }
+
+    // The stages of the half, the last one is clipped to [first, last].
+    int build_half(Half & half, int64_t first, int64_t last) const {
+        size_t n = half.items.size();
+        if (half.stages.size() < n)
+            half.stages.resize(n);
+
+        // rest_min[k], rest_max[k]: what the half's items after k add.
+        std::vector<int64_t> rest_min(n + 1, 0), rest_max(n + 1, 0);
+        for (ptrdiff_t k = (ptrdiff_t)n - 1; k >= 0; k--) {
+            const Item & item = this->items_[half.items[k]];
+            rest_min[k] = rest_min[k + 1] + item.min_count * item.min_price;
+            rest_max[k] = rest_max[k + 1] + item.max_count * item.max_price;
+        }
+
+        size_t total_bytes = 0;
+        for (size_t k = 0; k < n; k++) {
+            const SumBitSet & prev = this->stage_before(half, k);
+            const Item & item = this->items_[half.items[k]];
+            int64_t stage_first = (std::max)(prev.first() + item.min_count * item.min_price,
+                                             first - rest_max[k + 1]);
+            int64_t stage_last = (std::min)(prev.last() + item.max_count * item.max_price,
+                                            last - rest_min[k + 1]);
+            if (stage_first > stage_last)
+                return ExactStatus::Infeasible;
+
+            total_bytes += (size_t)((stage_last - stage_first) / 8 + 8);
+            if (total_bytes > kMaxMemoryBytes / 2)
+                return ExactStatus::TooLarge;
+
+            SumBitSet & next = half.stages[k];
+            next.reset(stage_first, stage_last);
+            if (!this->add_item(prev, item, next, half.scratch))
+                return ExactStatus::Timeout;
+            if (!next.any())
+                return ExactStatus::Infeasible;
+        }
+        return ExactStatus::Found;
+    }
+
+    void trace_answer(const Half & half, int64_t remain, std::vector<ExactChoice> & answer) {
+        for (ptrdiff_t k = (ptrdiff_t)half.items.size() - 1; k >= 0; k--) {
+            const Item & item = this->items_[half.items[k]];
+            ExactChoice choice;
+            bool found = this->find_choice(this->stage_before(half, (size_t)k), item, remain, choice);
+            assert(found);
+            (void)found;
+            answer[item.index] = choice;
+            remain -= choice.count * choice.price;
+        }
+        assert(remain == 0);
+    }
+};
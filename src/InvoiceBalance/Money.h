@@ -0,0 +1,164 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <assert.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <limits>
+
+//
+// Fixed-point money type, the value is stored as integer cents (1/100 yuan),
+// so the sum of (price * count) is always exact and can be compared with ==.
+//
+struct Money {
+    static const int64_t kCentsPerYuan = 100;
+
+    int64_t cents;
+
+    Money() : cents(0) {}
+    explicit Money(int64_t cents) : cents(cents) {}
+    Money(const Money & src) : cents(src.cents) {}
+
+    Money & operator = (const Money & rhs) {
+        this->cents = rhs.cents;
+        return *this;
+    }
+
+    static Money max() {
+        return Money((std::numeric_limits<int64_t>::max)());
+    }
+
+    static Money from_yuan(double yuan) {
+        // Half adjust, the same as round_currency(yuan, 100.0).
+        if (yuan >= 0.0)
+            return Money((int64_t)(yuan * kCentsPerYuan + 0.5));
+        else
+            return Money(-(int64_t)(-yuan * kCentsPerYuan + 0.5));
+    }
+
+    double to_yuan() const {
+        return ((double)this->cents / kCentsPerYuan);
+    }
+
+    bool is_zero() const {
+        return (this->cents == 0);
+    }
+
+    Money abs() const {
+        return Money((this->cents >= 0) ? this->cents : -this->cents);
+    }
+
+    //
+    // Parse a decimal string like "120000.00", "212.5" or "-2", the digits after
+    // the second decimal place are rounded (half adjust). No floating point is used,
+    // so a large total amount can't drift.
+    //
+    static bool parse(const std::string & str, Money & money) {
+        size_t pos = 0, len = str.size();
+        while (pos < len && (str[pos] == ' ' || str[pos] == '\t'))
+            pos++;
+
+        bool negative = false;
+        if (pos < len && (str[pos] == '+' || str[pos] == '-')) {
+            negative = (str[pos] == '-');
+            pos++;
+        }
+
+        int64_t integer = 0;
+        size_t digits = 0;
+        while (pos < len && str[pos] >= '0' && str[pos] <= '9') {
+            integer = integer * 10 + (str[pos] - '0');
+            pos++;
+            digits++;
+        }
+
+        int64_t fraction = 0;
+        if (pos < len && str[pos] == '.') {
+            pos++;
+            size_t places = 0;
+            while (pos < len && str[pos] >= '0' && str[pos] <= '9') {
+                if (places < 2) {
+                    fraction = fraction * 10 + (str[pos] - '0');
+                }
+                else if (places == 2) {
+                    // Half adjust
+                    if (str[pos] >= '5')
+                        fraction++;
+                }
+                pos++;
+                places++;
+                digits++;
+            }
+            if (places == 1)
+                fraction *= 10;
+        }
+
+        if (digits == 0)
+            return false;
+
+        int64_t cents = integer * kCentsPerYuan + fraction;
+        money.cents = (negative ? -cents : cents);
+        return true;
+    }
+
+    std::string to_string() const {
+        char buf[32];
+        int64_t cents = this->cents;
+        const char * sign = "";
+        if (cents < 0) {
+            sign = "-";
+            cents = -cents;
+        }
+        snprintf(buf, sizeof(buf), "%s%lld.%02d", sign,
+                 (long long)(cents / kCentsPerYuan), (int)(cents % kCentsPerYuan));
+        return std::string(buf);
+    }
+
+    Money & operator += (const Money & rhs) {
+        this->cents += rhs.cents;
+        return *this;
+    }
+
+    Money & operator -= (const Money & rhs) {
+        this->cents -= rhs.cents;
+        return *this;
+    }
+
+    Money operator - () const {
+        return Money(-this->cents);
+    }
+
+    friend Money operator + (const Money & lhs, const Money & rhs) {
+        return Money(lhs.cents + rhs.cents);
+    }
+
+    friend Money operator - (const Money & lhs, const Money & rhs) {
+        return Money(lhs.cents - rhs.cents);
+    }
+
+    friend Money operator * (const Money & price, int64_t count) {
+        return Money(price.cents * count);
+    }
+
+    friend Money operator * (int64_t count, const Money & price) {
+        return Money(price.cents * count);
+    }
+
+    // How many whole times a price fits into an amount (truncated towards zero),
+    // the price must be positive.
+    friend int64_t operator / (const Money & amount, const Money & price) {
+        assert(price.cents > 0);
+        return (amount.cents / price.cents);
+    }
+
+    friend bool operator == (const Money & lhs, const Money & rhs) { return (lhs.cents == rhs.cents); }
+    friend bool operator != (const Money & lhs, const Money & rhs) { return (lhs.cents != rhs.cents); }
+    friend bool operator <  (const Money & lhs, const Money & rhs) { return (lhs.cents <  rhs.cents); }
+    friend bool operator <= (const Money & lhs, const Money & rhs) { return (lhs.cents <= rhs.cents); }
+    friend bool operator >  (const Money & lhs, const Money & rhs) { return (lhs.cents >  rhs.cents); }
+    friend bool operator >= (const Money & lhs, const Money & rhs) { return (lhs.cents >= rhs.cents); }
+};
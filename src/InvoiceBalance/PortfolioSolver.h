@@ -0,0 +1,153 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+
+#include "ExactSolver.h"
+#include "CancelToken.h"
+
+//
+// One strategy of a portfolio search. run() searches until it finds a perfect answer
+// (ExactStatus::Found), proves that there is none (ExactStatus::Infeasible) or gives up,
+// and it gives up (ExactStatus::Timeout) soon after cancel_token is cancelled. A strategy
+// keeps its own scratch state, run() is called on its own thread.
+//
+class PortfolioStrategy
+{
+public:
+    virtual ~PortfolioStrategy() {}
+
+    virtual const char * name() const = 0;
+    virtual int run(CancelToken & cancel_token) = 0;
+};
+
+// A PortfolioStrategy of a function object: int function(CancelToken & cancel_token).
+template <typename Function>
+class FunctionStrategy : public PortfolioStrategy
+{
+private:
+    const char *    name_;
+    Function        function_;
+
+public:
+    FunctionStrategy(const char * name, Function function)
+        : name_(name), function_(function) {
+    }
+
+    const char * name() const {
+        return this->name_;
+    }
+
+    int run(CancelToken & cancel_token) {
+        return this->function_(cancel_token);
+    }
+};
+
+//
+// Races some strategies of the same problem, each one on its own thread. The first one to
+// settle it (a perfect answer, or a proof that there is none) wins and cancels the others,
+// so a search takes as long as the strategy which is the best for that invoice. If the
+// others may still find an approximate answer, a proof can be set not to end the race.
+//
+class PortfolioSolver
+{
+public:
+    static const size_t kNoWinner = size_t(-1);
+
+private:
+    std::vector<std::unique_ptr<PortfolioStrategy>> strategies_;
+    std::vector<int>        statuses_;
+    std::atomic<size_t>     winner_;
+    bool                    cancel_on_infeasible_;
+
+    PortfolioSolver(const PortfolioSolver &) = delete;
+    PortfolioSolver & operator = (const PortfolioSolver &) = delete;
+
+public:
+    PortfolioSolver() : winner_(kNoWinner), cancel_on_infeasible_(true) {
+    }
+
+    ~PortfolioSolver() {
+    }
+
+    void add(std::unique_ptr<PortfolioStrategy> strategy) {
+        this->strategies_.push_back(std::move(strategy));
+    }
+
+    template <typename Function>
+    void add(const char * name, Function function) {
+        this->add(std::unique_ptr<PortfolioStrategy>(new FunctionStrategy<Function>(name, function)));
+    }
+
+    // Whether a proof that there is no perfect answer (ExactStatus::Infeasible) wins the race.
+    void set_cancel_on_infeasible(bool cancel_on_infeasible) {
+        this->cancel_on_infeasible_ = cancel_on_infeasible;
+    }
+
+    size_t size() const {
+        return this->strategies_.size();
+    }
+
+    const char * name(size_t index) const {
+        return this->strategies_[index]->name();
+    }
+
+    // The ExactStatus of the strategy in the last race().
+    int status(size_t index) const {
+        return this->statuses_[index];
+    }
+
+    // The strategy which settled the last race(), kNoWinner if none did.
+    size_t winner() const {
+        return this->winner_.load();
+    }
+
+    //
+    // Runs all the strategies and waits for them. Returns ExactStatus::Found or Infeasible
+    // if a strategy settled the problem, or else Infeasible if one proved it but that doesn't
+    // win, else Timeout if one gave up on time (or was cancelled by someone else), else
+    // TooLarge. cancel_token is left cancelled if the race is won.
+    //
+    int race(CancelToken & cancel_token) {
+        size_t count = this->strategies_.size();
+        this->statuses_.assign(count, ExactStatus::TooLarge);
+        this->winner_.store(kNoWinner);
+
+        std::vector<std::thread> workers;
+        workers.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            workers.push_back(std::thread([this, i, &cancel_token]() {
+                int status = this->strategies_[i]->run(cancel_token);
+                this->statuses_[i] = status;
+                if (status == ExactStatus::Found
+                    || (status == ExactStatus::Infeasible && this->cancel_on_infeasible_)) {
+                    size_t no_winner = kNoWinner;
+                    if (this->winner_.compare_exchange_strong(no_winner, i))
+                        cancel_token.cancel();
+                }
+            }));
+        }
+        for (size_t i = 0; i < count; i++) {
+            workers[i].join();
+        }
+
+        size_t winner = this->winner_.load();
+        if (winner != kNoWinner)
+            return this->statuses_[winner];
+        int status = ExactStatus::TooLarge;
+        for (size_t i = 0; i < count; i++) {
+            if (this->statuses_[i] == ExactStatus::Infeasible)
+                return ExactStatus::Infeasible;
+            if (this->statuses_[i] == ExactStatus::Timeout)
+                status = ExactStatus::Timeout;
+        }
+        return status;
+    }
+};
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+#include <limits>
+
+#include "ExactSolver.h"
+
+struct PresolveReason {
+    enum {
+        Feasible,           // not proved infeasible, the solvers have to tell
+        NoGoods,
+        NoPrice,            // the price band of goods_index has no positive price
+        BelowMinimum,       // the total is below every goods at its minimum count and price
+        AboveMaximum,       // the total is above every goods at its maximum count and price
+        Residue             // the total isn't a multiple of the step of all the reachable totals
+    };
+};
+
+struct PresolveResult {
+    int         reason;
+    size_t      goods_index;        // NoPrice only
+    int64_t     min_total;
+    int64_t     max_total;          // -1 is unlimited
+    int64_t     step;               // every reachable total is a multiple of step
+    int64_t     nearest_total;      // the closest total that passes the checks (0 if none)
+
+    PresolveResult() : reason(PresolveReason::Feasible), goods_index(size_t(-1)),
+                       min_total(0), max_total(-1), step(1), nearest_total(0) {}
+
+    bool is_infeasible() const {
+        return (this->reason != PresolveReason::Feasible);
+    }
+
+    static const char * reason_name(int reason) {
+        switch (reason) {
+        case PresolveReason::Feasible:      return "feasible";
+        case PresolveReason::NoGoods:       return "no_goods";
+        case PresolveReason::NoPrice:       return "no_price";
+        case PresolveReason::BelowMinimum:  return "below_minimum";
+        case PresolveReason::AboveMaximum:  return "above_maximum";
+        case PresolveReason::Residue:       return "residue";
+        default:                            return "unknown";
+        }
+    }
+
+    const char * reason_name() const {
+        return reason_name(this->reason);
+    }
+};
+
+//
+// O(n) feasibility checks of an invoice (the same ExactItem as the exact solvers), run
+// before any search, so an invoice that provably has no perfect answer costs microseconds:
+//
+//   the bounds   every total is in [sum(min_count * min_price), sum(max_count * max_price)],
+//                the upper bound is unlimited if any goods has no count limit.
+//   the residue  the totals of a goods are multiples of gcd(counts) * gcd(prices), that is
+//                its count if the count range is one count, times its price if the band is
+//                one price. Every total is a multiple of the gcd of them over all the goods.
+//
+// The bounds themselves are reachable totals (all the goods at their minimum or maximum),
+// a multiple of the step in between is only the nearest total that passes these checks.
+//
+class Presolver
+{
+private:
+    static int64_t gcd(int64_t a, int64_t b) {
+        while (b != 0) {
+            int64_t t = a % b;
+            a = b;
+            b = t;
+        }
+        return a;
+    }
+
+    // a * b, saturated to int64 max (both are positive).
+    static int64_t saturate_mul(int64_t a, int64_t b) {
+        if (a != 0 && b > (std::numeric_limits<int64_t>::max)() / a)
+            return (std::numeric_limits<int64_t>::max)();
+        return (a * b);
+    }
+
+    static int64_t saturate_add(int64_t a, int64_t b) {
+        if (b > (std::numeric_limits<int64_t>::max)() - a)
+            return (std::numeric_limits<int64_t>::max)();
+        return (a + b);
+    }
+
+public:
+    static PresolveResult analyze(int64_t target, const std::vector<ExactItem> & items) {
+        PresolveResult result;
+        if (items.empty()) {
+            result.reason = PresolveReason::NoGoods;
+            return result;
+        }
+
+        int64_t min_total = 0, max_total = 0, step = 0;
+        bool unlimited = false;
+        for (size_t i = 0; i < items.size(); i++) {
+            const ExactItem & item = items[i];
+            int64_t min_price = (std::max)(item.min_price, int64_t(1));
+            int64_t max_price = item.max_price;
+            if (max_price < min_price) {
+                result.reason = PresolveReason::NoPrice;
+                result.goods_index = i;
+                return result;
+            }
+            int64_t min_count = (std::max)(item.min_count, int64_t(1));
+            int64_t max_count = item.max_count;
+
+            min_total = saturate_add(min_total, saturate_mul(min_count, min_price));
+            if (max_count >= min_count)
+                max_total = saturate_add(max_total, saturate_mul(max_count, max_price));
+            else
+                unlimited = true;
+
+            int64_t count_step = (max_count == min_count) ? min_count : 1;
+            int64_t price_step = (max_price == min_price) ? min_price : 1;
+            step = gcd(step, saturate_mul(count_step, price_step));
+        }
+
+        result.min_total = min_total;
+        result.max_total = unlimited ? -1 : max_total;
+        result.step = step;
+
+        if (target < min_total) {
+            result.reason = PresolveReason::BelowMinimum;
+            result.nearest_total = min_total;
+        }
+        else if (!unlimited && target > max_total) {
+            result.reason = PresolveReason::AboveMaximum;
+            result.nearest_total = max_total;
+        }
+        else if (step > 1 && target % step != 0) {
+            // min_total and max_total are multiples of step, so both neighbors are in the bounds.
+            int64_t lower = target - target % step;
+            int64_t upper = lower + step;
+            result.reason = PresolveReason::Residue;
+            result.nearest_total = (target - lower <= upper - target) ? lower : upper;
+        }
+        else {
+            result.nearest_total = target;
+        }
+        return result;
+    }
+};
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+#include <assert.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+
+//
+// xoshiro256** pseudo random generator, see: http://prng.di.unimi.it/
+//
+// Each solver (and each search worker) owns its own generator, so it's thread-safe without
+// any lock, and the same seed always replays the same search. split() hands out streams
+// that are 2^128 numbers apart for the parallel workers.
+//
+class RandomGenerator
+{
+private:
+    uint64_t    state_[4];
+    uint64_t    seed_;
+
+    // The second normal random number of the last Box-Muller pair.
+    double      spare_;
+    bool        has_spare_;
+
+    static uint64_t rotl(uint64_t x, int k) {
+        return ((x << k) | (x >> (64 - k)));
+    }
+
+    static uint64_t splitmix64(uint64_t & x) {
+        uint64_t z = (x += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return (z ^ (z >> 31));
+    }
+
+public:
+    RandomGenerator() {
+        this->seed(0);
+    }
+
+    explicit RandomGenerator(uint64_t seed) {
+        this->seed(seed);
+    }
+
+    void seed(uint64_t seed) {
+        this->seed_ = seed;
+        uint64_t x = seed;
+        for (size_t i = 0; i < 4; i++) {
+            this->state_[i] = splitmix64(x);
+        }
+        this->spare_ = 0.0;
+        this->has_spare_ = false;
+    }
+
+    uint64_t get_seed() const {
+        return this->seed_;
+    }
+
+    //
+    // Returns a generator starting where this one is, and moves this one 2^128 numbers
+    // ahead, so the returned streams never overlap each other.
+    //
+    RandomGenerator split() {
+        RandomGenerator stream(*this);
+        stream.has_spare_ = false;
+        this->jump();
+        return stream;
+    }
+
+    void jump() {
+        static const uint64_t kJump[] = {
+            0x180EC6D33CFD0ABAULL, 0xD5A61266F0C9392CULL,
+            0xA9582618E03FC9AAULL, 0x39ABDC4529B1661CULL
+        };
+        uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+        for (size_t i = 0; i < sizeof(kJump) / sizeof(kJump[0]); i++) {
+            for (int b = 0; b < 64; b++) {
+                if (kJump[i] & (uint64_t(1) << b)) {
+                    s0 ^= this->state_[0];
+                    s1 ^= this->state_[1];
+                    s2 ^= this->state_[2];
+                    s3 ^= this->state_[3];
+                }
+                this->next_random64();
+            }
+        }
+        this->state_[0] = s0;
+        this->state_[1] = s1;
+        this->state_[2] = s2;
+        this->state_[3] = s3;
+    }
+
+    uint64_t next_random64() {
+        uint64_t result = rotl(this->state_[1] * 5, 7) * 9;
+        uint64_t t = this->state_[1] << 17;
+        this->state_[2] ^= this->state_[0];
+        this->state_[3] ^= this->state_[1];
+        this->state_[1] ^= this->state_[2];
+        this->state_[0] ^= this->state_[3];
+        this->state_[2] ^= t;
+        this->state_[3] = rotl(this->state_[3], 45);
+        return result;
+    }
+
+    uint32_t next_random32() {
+        return (uint32_t)(this->next_random64() >> 32);
+    }
+
+    // Uniform in [0, 1)
+    double next_random_f() {
+        return ((this->next_random64() >> 11) * (1.0 / 9007199254740992.0));
+    }
+
+    //
+    // The polar form of the Box-Muller transform, it needs no sin() or cos(),
+    // see: https://www.zhihu.com/question/29971598
+    //
+    double next_random_box_muller(double mu, double sigma) {
+        if (this->has_spare_) {
+            this->has_spare_ = false;
+            return (this->spare_ * sigma + mu);
+        }
+
+        double u1, u2, s;
+        do {
+            u1 = this->next_random_f() * 2.0 - 1.0;
+            u2 = this->next_random_f() * 2.0 - 1.0;
+            s = u1 * u1 + u2 * u2;
+        } while (s >= 1.0 || s == 0.0);
+
+        double factor = sqrt(-2.0 * log(s) / s);
+        this->spare_ = u2 * factor;
+        this->has_spare_ = true;
+        return (u1 * factor * sigma + mu);
+    }
+
+    int32_t next_random_i32(int32_t min_num, int32_t max_num) {
+        if (min_num > max_num) {
+            int32_t temp = min_num;
+            min_num = max_num;
+            max_num = temp;
+        }
+        // Multiply-shift range reduction, it's cheaper than a division.
+        uint64_t range = (uint64_t)((int64_t)max_num - min_num + 1);
+        return (int32_t)(min_num + (int64_t)(((uint64_t)this->next_random32() * range) >> 32));
+    }
+
+    int64_t next_random_i64(int64_t min_num, int64_t max_num) {
+        if (min_num < max_num)
+            return (min_num + (int64_t)(this->next_random64() % uint64_t(max_num - min_num + 1)));
+        else if (min_num > max_num)
+            return (max_num + (int64_t)(this->next_random64() % uint64_t(min_num - max_num + 1)));
+        else
+            return min_num;
+    }
+
+    size_t next_random_64(size_t min_num, size_t max_num) {
+        if (min_num < max_num)
+            return (min_num + (size_t)(this->next_random64() % uint64_t(max_num - min_num + 1)));
+        else if (min_num > max_num)
+            return (max_num + (size_t)(this->next_random64() % uint64_t(min_num - max_num + 1)));
+        else
+            return min_num;
+    }
+
+    // Normal distribution, clipped to 3 sigma and translated to [0, 1].
+    double normal_dist_next_random() {
+        const double l_limit = -3.0, r_limit = 3.0;
+        double randomf = this->next_random_box_muller(0.0, 1.0);
+        if (randomf > r_limit)
+            randomf = r_limit;
+        else if (randomf < l_limit)
+            randomf = l_limit;
+
+        // normalize to [-1, 1]
+        randomf /= r_limit;
+
+        // translation to [0, 1]
+        randomf = (randomf + 1.0) / 2.0;
+        return randomf;
+    }
+
+    int32_t normal_dist_random_i32(int32_t min_num, int32_t max_num) {
+        double randomf = this->normal_dist_next_random();
+        assert(randomf >= 0.0 && randomf <= 1.0);
+
+        if (min_num < max_num)
+            return (min_num + int32_t(randomf * (max_num - min_num)));
+        else if (min_num > max_num)
+            return (max_num + int32_t(randomf * (min_num - max_num)));
+        else
+            return min_num;
+    }
+
+    int64_t normal_dist_random_i64(int64_t min_num, int64_t max_num) {
+        double randomf = this->normal_dist_next_random();
+
+        if (min_num < max_num)
+            return (min_num + int64_t(randomf * (max_num - min_num)));
+        else if (min_num > max_num)
+            return (max_num + int64_t(randomf * (min_num - max_num)));
+        else
+            return min_num;
+    }
+
+    size_t normal_dist_random_64(size_t min_num, size_t max_num) {
+        double randomf = this->normal_dist_next_random();
+
+        if (min_num < max_num)
+            return (min_num + size_t(randomf * (max_num - min_num)));
+        else if (min_num > max_num)
+            return (max_num + size_t(randomf * (min_num - max_num)));
+        else
+            return min_num;
+    }
+
+    double normal_dist_random_f(double minimun, double maximum) {
+        double randomf = this->normal_dist_next_random();
+
+        if (minimun < maximum)
+            return (minimun + randomf * (maximum - minimun));
+        else if (minimun > maximum)
+            return (maximum + randomf * (minimun - maximum));
+        else
+            return minimun;
+    }
+};
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+#include "Random.h"
+#include "CandidateBatch.h"
+
+//
+// One candidate of the random search, in structure-of-arrays storage: the restart loop reads
+// contiguous int64/int32 arrays instead of the Goods of a GoodsList, and the arrays are sized
+// once and kept between the searches. Every price is drawn from a normal distribution in its
+// band, then the goods are taken in a random order, each count from a normal distribution
+// in its range clipped by what is left of the total, and orders_[0] is the padding goods
+// (count 0), which the batch kernel fills in. All the amounts are in cents.
+//
+class SearchCandidate
+{
+private:
+    int64_t     total_amount_;
+    int64_t     fluctuation_;
+
+    // Per goods: the input price, the lowest price of the band (at least 1 cent) and
+    // the count range, max_counts_ is less than min_counts_ if it's unlimited.
+    std::vector<int64_t>    input_prices_;
+    std::vector<int64_t>    min_prices_;
+    std::vector<int32_t>    min_counts_;
+    std::vector<int32_t>    max_counts_;
+    std::vector<double>     padding_maxs_;
+
+    // The drawn candidate, orders_[0] is the padding goods (its count stays 0).
+    std::vector<int64_t>    prices_;
+    std::vector<int32_t>    counts_;
+    std::vector<size_t>     orders_;
+    int64_t         min_remaining_;
+
+public:
+    SearchCandidate() : total_amount_(0), fluctuation_(0), min_remaining_(0) {
+    }
+
+    // Sizes the arrays and clears the goods, before set_goods().
+    void resize(size_t goods_count) {
+        this->input_prices_.resize(goods_count);
+        this->min_prices_.resize(goods_count);
+        this->min_counts_.resize(goods_count);
+        this->max_counts_.resize(goods_count);
+        this->padding_maxs_.resize(goods_count);
+        this->prices_.resize(goods_count);
+        this->counts_.resize(goods_count);
+        this->orders_.resize(goods_count);
+        for (size_t i = 0; i < goods_count; i++) {
+            this->input_prices_[i] = 0;
+            this->min_prices_[i] = 1;
+            this->min_counts_[i] = 1;
+            this->max_counts_[i] = 0;
+            this->padding_maxs_[i] = (std::numeric_limits<double>::max)();
+            this->prices_[i] = 0;
+            this->counts_[i] = 0;
+            this->orders_[i] = i;
+        }
+    }
+
+    size_t size() const { return this->prices_.size(); }
+
+    void set_total_amount(int64_t total_amount, int64_t fluctuation) {
+        this->total_amount_ = total_amount;
+        this->fluctuation_ = fluctuation;
+    }
+
+    void set_goods(size_t i, int64_t price, int32_t min_count, int32_t max_count) {
+        assert(i < this->size());
+        int32_t min_amount = (std::max)(min_count, 1);
+        this->input_prices_[i] = price;
+        this->min_prices_[i] = (std::max)(price - this->fluctuation_, int64_t(1));
+        this->min_counts_[i] = min_amount;
+        this->max_counts_[i] = max_count;
+        this->padding_maxs_[i] = (max_count >= min_amount) ? (double)max_count
+                                                           : (std::numeric_limits<double>::max)();
+    }
+
+    int64_t price(size_t i) const { return this->prices_[i]; }
+    int32_t count(size_t i) const { return this->counts_[i]; }
+    // The i-th goods of the draw order, the counts are drawn from the last one down.
+    size_t order(size_t i) const { return this->orders_[i]; }
+    size_t padding_idx() const { return this->orders_[0]; }
+
+    void draw_prices(RandomGenerator & random) {
+        size_t n = this->size();
+        int64_t fluctuation = this->fluctuation_;
+        int64_t min_remaining = 0;
+        for (size_t i = 0; i < n; i++) {
+            int64_t price_change = 0;
+            if (fluctuation != 0)
+                price_change = random.normal_dist_random_i64(-fluctuation, fluctuation);
+            // The band is clipped at 1 cent, a low price minus the fluctuation may be below it.
+            this->prices_[i] = (std::max)(this->input_prices_[i] + price_change, this->min_prices_[i]);
+            this->counts_[i] = 0;
+            this->orders_[i] = i;
+            min_remaining += this->prices_[i] * this->min_counts_[i];
+        }
+        this->min_remaining_ = min_remaining;
+    }
+
+    //
+    // Returns false if the counts can't fit the total amount. The running totals make it
+    // O(n), the minimum amount of the goods which have no count yet is min_remaining.
+    //
+    bool draw_counts(RandomGenerator & random) {
+        ptrdiff_t n = (ptrdiff_t)this->size();
+        for (ptrdiff_t i = n - 1; i >= 1; i--) {
+            size_t idx = (size_t)random.next_random_i32(0, (int32_t)i);
+            std::swap(this->orders_[i], this->orders_[idx]);
+        }
+
+        int64_t min_remaining = this->min_remaining_;
+        int64_t assigned_amount = 0;
+        for (ptrdiff_t i = n - 1; i >= 1; i--) {
+            size_t idx = this->orders_[i];
+            int32_t min_amount = this->min_counts_[idx];
+            int32_t max_amount = this->max_counts_[idx];
+            min_remaining -= this->prices_[idx] * min_amount;
+
+            int64_t free_amount = this->total_amount_ - assigned_amount - min_remaining;
+            int32_t actual_max_goods_amount = (free_amount >= 0) ? (int32_t)(free_amount / this->min_prices_[idx]) : -1;
+            if (max_amount >= min_amount)
+                max_amount = (std::min)(max_amount, actual_max_goods_amount);
+            else
+                max_amount = actual_max_goods_amount;
+            if (min_amount > max_amount)
+                return false;
+
+            int32_t rand_amount = random.normal_dist_random_i32(min_amount, max_amount);
+            assert(rand_amount >= min_amount);
+            this->counts_[idx] = rand_amount;
+            assigned_amount += this->prices_[idx] * rand_amount;
+        }
+        return true;
+    }
+
+    void store(CandidateBatch & batch) const {
+        const size_t K = CandidateBatch::kBatchSize;
+        size_t n = this->size();
+        assert(batch.goods_count == n);
+        size_t k = batch.size++;
+        for (size_t i = 0; i < n; i++) {
+            batch.prices[i * K + k] = (double)this->prices_[i];
+            batch.counts[i * K + k] = (double)this->counts_[i];
+        }
+        size_t padding_idx = this->orders_[0];
+        batch.padding_prices[k] = (double)this->prices_[padding_idx];
+        batch.padding_mins[k] = (double)this->min_counts_[padding_idx];
+        batch.padding_maxs[k] = this->padding_maxs_[padding_idx];
+    }
+};
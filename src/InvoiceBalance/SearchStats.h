@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+//
+// The counters of one search, they tell why an invoice shape burns all the restarts:
+//
+//   restarts               the candidates drawn
+//   rejected_restarts      the candidates given up while drawing the counts, because the
+//                          count range of a goods can't fit the rest of the total (min > max)
+//   padding_out_of_range   the padding count is below its range min (or above its max)
+//   improvements           the better answers recorded
+//
+// The phase times (price draw, count draw, and adjust, which is the padding and the price
+// adjustment) are only measured if the timing is enabled, it costs a clock read per phase.
+//
+struct SearchStats {
+    uint64_t    restarts;
+    uint64_t    rejected_restarts;
+    uint64_t    padding_out_of_range;
+    uint64_t    improvements;
+
+    int64_t     price_draw_ns;
+    int64_t     count_draw_ns;
+    int64_t     adjust_ns;
+
+    SearchStats() {
+        this->clear();
+    }
+
+    void clear() {
+        this->restarts = 0;
+        this->rejected_restarts = 0;
+        this->padding_out_of_range = 0;
+        this->improvements = 0;
+        this->price_draw_ns = 0;
+        this->count_draw_ns = 0;
+        this->adjust_ns = 0;
+    }
+
+    // Adds the counters of a search worker.
+    void merge(const SearchStats & other) {
+        this->restarts += other.restarts;
+        this->rejected_restarts += other.rejected_restarts;
+        this->padding_out_of_range += other.padding_out_of_range;
+        this->improvements += other.improvements;
+        this->price_draw_ns += other.price_draw_ns;
+        this->count_draw_ns += other.count_draw_ns;
+        this->adjust_ns += other.adjust_ns;
+    }
+
+    // One line of JSON, the times are in milliseconds.
+    std::string to_json() const {
+        char buf[512];
+        snprintf(buf, sizeof(buf),
+                 "{\"restarts\":%llu,\"rejected_restarts\":%llu,"
+                 "\"padding_out_of_range\":%llu,\"improvements\":%llu,"
+                 "\"price_draw_ms\":%0.3f,\"count_draw_ms\":%0.3f,\"adjust_ms\":%0.3f}",
+                 (unsigned long long)this->restarts,
+                 (unsigned long long)this->rejected_restarts,
+                 (unsigned long long)this->padding_out_of_range,
+                 (unsigned long long)this->improvements,
+                 (double)this->price_draw_ns / 1.0e6,
+                 (double)this->count_draw_ns / 1.0e6,
+                 (double)this->adjust_ns / 1.0e6);
+        return std::string(buf);
+    }
+};
@@ -0,0 +1,406 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <algorithm>
+#include <mutex>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "ExactSolver.h"
+
+//
+// One goods line of a cached problem, the price is in cents.
+//
+struct CacheGoods {
+    int64_t price;
+    int32_t min_count;
+    int32_t max_count;      // 0 is unlimited
+
+    CacheGoods() : price(0), min_count(1), max_count(0) {}
+    CacheGoods(int64_t price, int32_t min_count, int32_t max_count)
+        : price(price), min_count(min_count), max_count(max_count) {}
+};
+
+//
+// Cache of the perfect answers, keyed by the normalized problem: the total amount, the
+// fluctuation and the goods sorted by (price, count range). So the same invoice with its
+// goods in another order is the same key, the answer is stored in the sorted order and
+// mapped back to the order of the caller.
+//
+// An in-memory LRU of kDefaultCapacity problems is in front of an optional on-disk store,
+// a memory-mapped file of kFileSlots direct-mapped records (a newer problem with the same
+// slot replaces the older one). The file is shared by the runs, not locked between the
+// processes: every hit is checked against the problem (prices in the band, counts in the
+// ranges, and the total is exact) before it's returned, a bad record is only a miss.
+//
+// The methods are thread-safe, the batch and daemon workers share one cache.
+//
+class SolutionCache
+{
+public:
+    static const size_t   kDefaultCapacity = 4096;
+    static const size_t   kMaxGoods = 20;
+    static const uint32_t kFileSlots = 16384;
+    static const uint32_t kFileMagic = 0x43564E49;     // "INVC"
+    static const uint32_t kFileVersion = 1;
+
+private:
+    struct RecordGoods {
+        int64_t price;
+        int32_t min_count;
+        int32_t max_count;
+        int64_t answer_price;
+        int64_t answer_count;
+    };
+
+    // The same layout in memory and on disk.
+    struct Record {
+        uint64_t    hash;
+        int64_t     total_amount;
+        int64_t     fluctuation;
+        uint32_t    goods_count;
+        uint32_t    used;
+        RecordGoods goods[kMaxGoods];
+    };
+
+    struct FileHeader {
+        uint32_t    magic;
+        uint32_t    version;
+        uint32_t    slot_count;
+        uint32_t    record_size;
+    };
+
+    typedef std::list<Record>                                   LruList;
+    typedef std::unordered_map<uint64_t, LruList::iterator>     LruMap;
+
+    size_t      capacity_;
+    LruList     lru_;
+    LruMap      lru_map_;
+
+    FileHeader *    file_header_;
+    Record *        file_records_;
+    size_t          file_size_;
+#if defined(_WIN32)
+    HANDLE          file_handle_;
+    HANDLE          mapping_handle_;
+#else
+    int             file_fd_;
+#endif
+
+    size_t      hits_;
+    size_t      misses_;
+
+    std::mutex  mutex_;
+
+public:
+    explicit SolutionCache(size_t capacity = kDefaultCapacity)
+        : capacity_((std::max)(capacity, size_t(1))),
+          file_header_(nullptr), file_records_(nullptr), file_size_(0),
+#if defined(_WIN32)
+          file_handle_(INVALID_HANDLE_VALUE), mapping_handle_(NULL),
+#else
+          file_fd_(-1),
+#endif
+          hits_(0), misses_(0) {
+    }
+
+    ~SolutionCache() {
+        this->close();
+    }
+
+    //
+    // Maps the on-disk store, it's created (sparse) if it doesn't exist. A file of another
+    // version or layout is started over. Without a file the cache is only in memory.
+    //
+    bool open(const char * path) {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        this->unmap_file();
+
+        size_t file_size = sizeof(FileHeader) + sizeof(Record) * kFileSlots;
+        if (!this->map_file(path, file_size))
+            return false;
+
+        FileHeader * header = this->file_header_;
+        if (header->magic != kFileMagic || header->version != kFileVersion
+            || header->slot_count != kFileSlots || header->record_size != sizeof(Record)) {
+            // A new file is all zeros already (and stays sparse).
+            if (header->magic != 0)
+                memset((void *)this->file_records_, 0, sizeof(Record) * kFileSlots);
+            header->magic = kFileMagic;
+            header->version = kFileVersion;
+            header->slot_count = kFileSlots;
+            header->record_size = sizeof(Record);
+        }
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        this->unmap_file();
+    }
+
+    bool is_file_open() const {
+        return (this->file_records_ != nullptr);
+    }
+
+    size_t hit_count() const {
+        return this->hits_;
+    }
+
+    size_t miss_count() const {
+        return this->misses_;
+    }
+
+    //
+    // Looks up the perfect answer of the problem, the answer is in the order of goods.
+    // Returns false if there is none, or if the stored one doesn't sum to total_amount.
+    //
+    bool lookup(int64_t total_amount, int64_t fluctuation,
+                const std::vector<CacheGoods> & goods, std::vector<ExactChoice> & answer) {
+        Record key;
+        std::vector<size_t> order;
+        if (!make_key(total_amount, fluctuation, goods, key, order))
+            return false;
+
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        const Record * record = nullptr;
+        LruMap::iterator iter = this->lru_map_.find(key.hash);
+        if (iter != this->lru_map_.end() && same_problem(*iter->second, key)) {
+            this->lru_.splice(this->lru_.begin(), this->lru_, iter->second);
+            record = &this->lru_.front();
+        }
+        else if (this->file_records_ != nullptr) {
+            const Record & slot = this->file_records_[key.hash % kFileSlots];
+            if (slot.used != 0 && same_problem(slot, key)) {
+                this->insert_lru(slot);
+                record = &this->lru_.front();
+            }
+        }
+
+        if (record == nullptr || !is_exact_answer(*record)) {
+            this->misses_++;
+            return false;
+        }
+
+        answer.resize(goods.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            answer[order[i]].price = record->goods[i].answer_price;
+            answer[order[i]].count = record->goods[i].answer_count;
+        }
+        this->hits_++;
+        return true;
+    }
+
+    // Stores a perfect answer (in the order of goods), the others are ignored.
+    void store(int64_t total_amount, int64_t fluctuation,
+               const std::vector<CacheGoods> & goods, const std::vector<ExactChoice> & answer) {
+        Record record;
+        std::vector<size_t> order;
+        if (answer.size() != goods.size() || !make_key(total_amount, fluctuation, goods, record, order))
+            return;
+        for (size_t i = 0; i < order.size(); i++) {
+            record.goods[i].answer_price = answer[order[i]].price;
+            record.goods[i].answer_count = answer[order[i]].count;
+        }
+        if (!is_exact_answer(record))
+            return;
+
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        this->insert_lru(record);
+        if (this->file_records_ != nullptr) {
+            this->file_records_[record.hash % kFileSlots] = record;
+        }
+    }
+
+private:
+    static uint64_t fnv1a_64(uint64_t hash, int64_t value) {
+        uint64_t bits = (uint64_t)value;
+        for (size_t i = 0; i < sizeof(bits); i++) {
+            hash ^= (bits >> (i * 8)) & 0xFF;
+            hash *= 0x100000001B3ULL;
+        }
+        return hash;
+    }
+
+    //
+    // The normalized problem: the count ranges as the solvers read them (min >= 1, max is
+    // 0 if unlimited), the goods sorted, and order[i] is the input index of sorted goods i.
+    //
+    static bool make_key(int64_t total_amount, int64_t fluctuation, const std::vector<CacheGoods> & goods,
+                         Record & key, std::vector<size_t> & order) {
+        size_t goods_count = goods.size();
+        if (goods_count == 0 || goods_count > kMaxGoods)
+            return false;
+
+        std::vector<CacheGoods> normalized(goods);
+        for (size_t i = 0; i < goods_count; i++) {
+            CacheGoods & item = normalized[i];
+            item.min_count = (std::max)(item.min_count, int32_t(1));
+            if (item.max_count < item.min_count)
+                item.max_count = 0;
+        }
+
+        order.resize(goods_count);
+        for (size_t i = 0; i < goods_count; i++) {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), [&normalized](size_t lhs, size_t rhs) {
+            const CacheGoods & a = normalized[lhs];
+            const CacheGoods & b = normalized[rhs];
+            if (a.price != b.price)
+                return (a.price < b.price);
+            if (a.min_count != b.min_count)
+                return (a.min_count < b.min_count);
+            return (a.max_count < b.max_count);
+        });
+
+        memset((void *)&key, 0, sizeof(key));
+        key.total_amount = total_amount;
+        key.fluctuation = (fluctuation >= 0) ? fluctuation : -fluctuation;
+        key.goods_count = (uint32_t)goods_count;
+        key.used = 1;
+
+        uint64_t hash = 0xCBF29CE484222325ULL;
+        hash = fnv1a_64(hash, key.total_amount);
+        hash = fnv1a_64(hash, key.fluctuation);
+        hash = fnv1a_64(hash, (int64_t)goods_count);
+        for (size_t i = 0; i < goods_count; i++) {
+            const CacheGoods & item = normalized[order[i]];
+            key.goods[i].price = item.price;
+            key.goods[i].min_count = item.min_count;
+            key.goods[i].max_count = item.max_count;
+            hash = fnv1a_64(hash, item.price);
+            hash = fnv1a_64(hash, ((int64_t)item.min_count << 32) | (uint32_t)item.max_count);
+        }
+        key.hash = hash;
+        return true;
+    }
+
+    static bool same_problem(const Record & record, const Record & key) {
+        if (record.hash != key.hash || record.total_amount != key.total_amount
+            || record.fluctuation != key.fluctuation || record.goods_count != key.goods_count)
+            return false;
+        for (uint32_t i = 0; i < key.goods_count; i++) {
+            if (record.goods[i].price != key.goods[i].price
+                || record.goods[i].min_count != key.goods[i].min_count
+                || record.goods[i].max_count != key.goods[i].max_count)
+                return false;
+        }
+        return true;
+    }
+
+    static bool is_exact_answer(const Record & record) {
+        if (record.goods_count == 0 || record.goods_count > kMaxGoods)
+            return false;
+        int64_t total = 0;
+        for (uint32_t i = 0; i < record.goods_count; i++) {
+            const RecordGoods & item = record.goods[i];
+            int64_t price_change = item.answer_price - item.price;
+            if (price_change > record.fluctuation || price_change < -record.fluctuation || item.answer_price <= 0)
+                return false;
+            if (item.answer_count < item.min_count || (item.max_count != 0 && item.answer_count > item.max_count))
+                return false;
+            total += item.answer_price * item.answer_count;
+        }
+        return (total == record.total_amount);
+    }
+
+    void insert_lru(const Record & record) {
+        LruMap::iterator iter = this->lru_map_.find(record.hash);
+        if (iter != this->lru_map_.end()) {
+            *iter->second = record;
+            this->lru_.splice(this->lru_.begin(), this->lru_, iter->second);
+            return;
+        }
+        if (this->lru_.size() >= this->capacity_) {
+            this->lru_map_.erase(this->lru_.back().hash);
+            this->lru_.pop_back();
+        }
+        this->lru_.push_front(record);
+        this->lru_map_[record.hash] = this->lru_.begin();
+    }
+
+#if defined(_WIN32)
+    bool map_file(const char * path, size_t file_size) {
+        this->file_handle_ = ::CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                           NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (this->file_handle_ == INVALID_HANDLE_VALUE)
+            return false;
+        this->mapping_handle_ = ::CreateFileMappingA(this->file_handle_, NULL, PAGE_READWRITE,
+                                                     (DWORD)((uint64_t)file_size >> 32), (DWORD)file_size, NULL);
+        if (this->mapping_handle_ != NULL) {
+            void * view = ::MapViewOfFile(this->mapping_handle_, FILE_MAP_ALL_ACCESS, 0, 0, file_size);
+            if (view != NULL) {
+                this->file_header_ = (FileHeader *)view;
+                this->file_records_ = (Record *)((char *)view + sizeof(FileHeader));
+                this->file_size_ = file_size;
+                return true;
+            }
+        }
+        this->unmap_file();
+        return false;
+    }
+
+    void unmap_file() {
+        if (this->file_header_ != nullptr)
+            ::UnmapViewOfFile(this->file_header_);
+        if (this->mapping_handle_ != NULL)
+            ::CloseHandle(this->mapping_handle_);
+        if (this->file_handle_ != INVALID_HANDLE_VALUE)
+            ::CloseHandle(this->file_handle_);
+        this->mapping_handle_ = NULL;
+        this->file_handle_ = INVALID_HANDLE_VALUE;
+        this->file_header_ = nullptr;
+        this->file_records_ = nullptr;
+        this->file_size_ = 0;
+    }
+#else
+    bool map_file(const char * path, size_t file_size) {
+        this->file_fd_ = ::open(path, O_RDWR | O_CREAT, 0644);
+        if (this->file_fd_ < 0)
+            return false;
+        struct stat st;
+        if (::fstat(this->file_fd_, &st) == 0
+            && ((size_t)st.st_size == file_size || ::ftruncate(this->file_fd_, (off_t)file_size) == 0)) {
+            void * view = ::mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, this->file_fd_, 0);
+            if (view != MAP_FAILED) {
+                this->file_header_ = (FileHeader *)view;
+                this->file_records_ = (Record *)((char *)view + sizeof(FileHeader));
+                this->file_size_ = file_size;
+                return true;
+            }
+        }
+        this->unmap_file();
+        return false;
+    }
+
+    void unmap_file() {
+        if (this->file_header_ != nullptr)
+            ::munmap((void *)this->file_header_, this->file_size_);
+        if (this->file_fd_ >= 0)
+            ::close(this->file_fd_);
+        this->file_fd_ = -1;
+        this->file_header_ = nullptr;
+        this->file_records_ = nullptr;
+        this->file_size_ = 0;
+    }
+#endif // _WIN32
+};
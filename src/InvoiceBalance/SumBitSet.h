@@ -0,0 +1,217 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+
+//
+// A bitset over a window of sums (in cents): bit i means "base + i is reachable".
+// Only the window [base, base + size) is stored, everything outside is unreachable.
+//
+// The storage has one zero guard word before and after the bits, so the shifting
+// loops can read one word out of the range without any branch.
+//
+class SumBitSet
+{
+public:
+    typedef uint64_t    word_type;
+
+    static const size_t kWordBits = 64;
+
+private:
+    int64_t                 base_;
+    int64_t                 size_;
+    size_t                  nwords_;
+    std::vector<word_type>  words_;
+    std::vector<word_type>  temp_;
+
+    static size_t word_count(int64_t nbits) {
+        return (size_t)((nbits + kWordBits - 1) / kWordBits);
+    }
+
+    word_type * data() { return (this->words_.data() + 1); }
+    const word_type * data() const { return (this->words_.data() + 1); }
+
+public:
+    SumBitSet() : base_(0), size_(0), nwords_(0) {
+    }
+
+    SumBitSet(int64_t first, int64_t last) : base_(0), size_(0), nwords_(0) {
+        this->reset(first, last);
+    }
+
+    int64_t first() const { return this->base_; }
+    int64_t last() const { return (this->base_ + this->size_ - 1); }
+    int64_t size() const { return this->size_; }
+    bool empty() const { return (this->size_ <= 0); }
+
+    size_t bytes() const {
+        return ((this->words_.size() + this->temp_.size()) * sizeof(word_type));
+    }
+
+    // Resize to the window [first, last] and clear all bits, the capacity is kept.
+    void reset(int64_t first, int64_t last) {
+        this->base_ = first;
+        this->size_ = (last >= first) ? (last - first + 1) : 0;
+        this->nwords_ = word_count(this->size_);
+        if (this->words_.size() < this->nwords_ + 2)
+            this->words_.resize(this->nwords_ + 2);
+        std::fill(this->words_.begin(), this->words_.begin() + this->nwords_ + 2, word_type(0));
+    }
+
+    bool test(int64_t sum) const {
+        int64_t pos = sum - this->base_;
+        if (pos < 0 || pos >= this->size_)
+            return false;
+        return ((this->data()[(size_t)(pos / kWordBits)] >> (pos % kWordBits)) & 1) != 0;
+    }
+
+    void set(int64_t sum) {
+        int64_t pos = sum - this->base_;
+        if (pos >= 0 && pos < this->size_) {
+            this->data()[(size_t)(pos / kWordBits)] |= word_type(1) << (pos % kWordBits);
+        }
+    }
+
+    bool any() const {
+        const word_type * d = this->data();
+        for (size_t i = 0; i < this->nwords_; i++) {
+            if (d[i] != 0)
+                return true;
+        }
+        return false;
+    }
+
+    //
+    // this |= (src + shift), the bits falling outside of this window are dropped.
+    //
+    void or_shifted(const SumBitSet & src, int64_t shift) {
+        if (this->empty() || src.empty())
+            return;
+        // Bit i of src lands on bit (i + offset) of this.
+        int64_t offset = src.base_ + shift - this->base_;
+        int64_t dst_first = (std::max)(offset, int64_t(0));
+        int64_t dst_last = (std::min)(offset + src.size_, this->size_) - 1;
+        if (dst_first > dst_last)
+            return;
+
+        ptrdiff_t first_word = (ptrdiff_t)(dst_first / kWordBits);
+        ptrdiff_t last_word = (ptrdiff_t)(dst_last / kWordBits);
+        word_type * __restrict d = this->data();
+
+        if (offset >= 0) {
+            ptrdiff_t q = (ptrdiff_t)(offset / kWordBits);
+            unsigned r = (unsigned)(offset % kWordBits);
+            // d[w] gets s[w - q] and the high bits of s[w - q - 1], s[-1] is the guard word.
+            const word_type * __restrict s = src.data();
+            if (r == 0) {
+                for (ptrdiff_t w = first_word; w <= last_word; w++)
+                    d[w] |= s[w - q];
+            }
+            else {
+                unsigned l = (unsigned)kWordBits - r;
+                for (ptrdiff_t w = first_word; w <= last_word; w++)
+                    d[w] |= (s[w - q] << r) | (s[w - q - 1] >> l);
+            }
+        }
+        else {
+            ptrdiff_t q = (ptrdiff_t)((-offset) / kWordBits);
+            unsigned r = (unsigned)((-offset) % kWordBits);
+            // d[w] gets s[w + q] and the low bits of s[w + q + 1], s[nwords] is the guard word.
+            const word_type * __restrict s = src.data();
+            if (r == 0) {
+                for (ptrdiff_t w = first_word; w <= last_word; w++)
+                    d[w] |= s[w + q];
+            }
+            else {
+                unsigned l = (unsigned)kWordBits - r;
+                for (ptrdiff_t w = first_word; w <= last_word; w++)
+                    d[w] |= (s[w + q] >> r) | (s[w + q + 1] << l);
+            }
+        }
+        this->clear_tail();
+    }
+
+    //
+    // Every reachable sum s becomes { s, s + step, s + 2 * step, ..., s + (terms - 1) * step }.
+    //
+    void dilate(int64_t step, int64_t terms) {
+        assert(step > 0);
+        if (this->empty() || terms <= 1)
+            return;
+        if ((terms - 1) * step >= this->size_ && step >= (int64_t)kWordBits) {
+            // Every shift beyond the window is dropped, a single forward pass is enough.
+            this->close_stride(step);
+            return;
+        }
+        int64_t covered = 1;
+        while (covered < terms) {
+            int64_t span = (std::min)(covered, terms - covered);
+            if (span * step >= this->size_)
+                break;
+            this->or_self_shifted(span * step);
+            covered += span;
+        }
+    }
+
+private:
+    void clear_tail() {
+        unsigned tail = (unsigned)(this->size_ % kWordBits);
+        if (tail != 0) {
+            this->data()[this->nwords_ - 1] &= (word_type(1) << tail) - 1;
+        }
+    }
+
+    // this |= (this << shift), written to the temp buffer and swapped, so the loop can be vectorized.
+    void or_self_shifted(int64_t shift) {
+        assert(shift > 0);
+        ptrdiff_t nwords = (ptrdiff_t)this->nwords_;
+        ptrdiff_t q = (ptrdiff_t)(shift / kWordBits);
+        unsigned r = (unsigned)(shift % kWordBits);
+        if (this->temp_.size() < this->words_.size())
+            this->temp_.resize(this->words_.size());
+
+        const word_type * __restrict s = this->data();
+        word_type * __restrict d = this->temp_.data() + 1;
+        d[-1] = 0;
+        d[nwords] = 0;
+        ptrdiff_t split = (std::min)(q, nwords);
+        for (ptrdiff_t w = 0; w < split; w++)
+            d[w] = s[w];
+        if (r == 0) {
+            for (ptrdiff_t w = split; w < nwords; w++)
+                d[w] = s[w] | s[w - q];
+        }
+        else {
+            unsigned l = (unsigned)kWordBits - r;
+            for (ptrdiff_t w = split; w < nwords; w++)
+                d[w] = s[w] | (s[w - q] << r) | (s[w - q - 1] >> l);
+        }
+        this->words_.swap(this->temp_);
+        this->clear_tail();
+    }
+
+    // bit[x] |= bit[x - step] for all x ascending, requires (step >= 64).
+    void close_stride(int64_t step) {
+        assert(step >= (int64_t)kWordBits);
+        ptrdiff_t nwords = (ptrdiff_t)this->nwords_;
+        ptrdiff_t q = (ptrdiff_t)(step / kWordBits);
+        unsigned r = (unsigned)(step % kWordBits);
+        word_type * d = this->data();
+        if (r == 0) {
+            for (ptrdiff_t w = q; w < nwords; w++)
+                d[w] |= d[w - q];
+        }
+        else {
+            unsigned l = (unsigned)kWordBits - r;
+            for (ptrdiff_t w = q; w < nwords; w++)
+                d[w] |= (d[w - q] << r) | (d[w - q - 1] >> l);
+        }
+        this->clear_tail();
+    }
+};
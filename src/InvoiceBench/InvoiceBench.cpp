@@ -0,0 +1,227 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include "InvoiceBalance/InvoiceBalance.h"
+
+//
+// Microbenchmarks of the building blocks of the search, on generated problems of some
+// goods counts and total amounts. Each result is one JSON line on stdout:
+//
+//   {"bench":"draw_prices","goods":5,"total":"100000.00","ops":4194304,"ns_per_op":3.052}
+//
+// Every case is repeated (doubling the ops) until it runs kMinCaseTime at least, so the
+// results of two builds can be compared line by line to catch a slower hot path.
+//
+// InvoiceBench [--seed N] [--filter NAME] [--quick]
+//
+class InvoiceBench
+{
+public:
+    typedef InvoiceBalance::GoodsList   GoodsList;
+
+private:
+    uint64_t        seed_;
+    std::string     filter_;
+    double          min_case_time_;
+
+    // Keeps the results alive, so the compiler can't drop the timed calls.
+    volatile int64_t    sink_;
+
+    struct Problem {
+        Money       total_amount;
+        Money       fluctuation;
+        GoodsList   goods;
+    };
+
+public:
+    static const size_t kGoodsCounts[];
+    static const double kTotalAmounts[];
+
+    InvoiceBench(uint64_t seed, const std::string & filter, bool quick)
+        : seed_(seed), filter_(filter), min_case_time_(quick ? 0.005 : 0.05), sink_(0) {
+    }
+
+    void run() {
+        for (size_t g = 0; kGoodsCounts[g] != 0; g++) {
+            for (size_t t = 0; kTotalAmounts[t] != 0.0; t++) {
+                Problem problem;
+                this->generate_problem(kGoodsCounts[g], Money::from_yuan(kTotalAmounts[t]), problem);
+                this->run_problem(problem);
+            }
+        }
+    }
+
+private:
+    //
+    // Prices are drawn from [10.00, 500.00] yuan, the fluctuation is 2.00 and the counts
+    // are unlimited, so the same seed always generates the same problems.
+    //
+    void generate_problem(size_t goods_count, Money total_amount, Problem & problem) {
+        RandomGenerator random(this->seed_ + goods_count * 1000003 + (uint64_t)total_amount.cents);
+        problem.total_amount = total_amount;
+        problem.fluctuation = Money::from_yuan(2.0);
+        problem.goods.resize(goods_count);
+        for (size_t i = 0; i < goods_count; i++) {
+            problem.goods[i].price = Money(random.next_random_i64(1000, 50000));
+            problem.goods[i].count = 0;
+            problem.goods[i].count_range = CountRange(1, 0);
+        }
+    }
+
+    void prepare(InvoiceBalance & balance, const Problem & problem) {
+        balance.set_verbose(false);
+        balance.set_random_seed(this->seed_);
+        balance.set_total_amount(problem.total_amount, problem.fluctuation);
+        balance.set_price_and_count(problem.goods);
+        balance.normalize_prices();
+    }
+
+    // Fills the batch with candidates whose counts fit the total, as the search does.
+    bool fill_batch(SearchCandidate & candidate, RandomGenerator & random, CandidateBatch & batch) {
+        batch.size = 0;
+        while (!batch.full()) {
+            size_t tries = 0;
+            for (;;) {
+                candidate.draw_prices(random);
+                if (candidate.draw_counts(random))
+                    break;
+                if (++tries >= 1000)
+                    return false;
+            }
+            candidate.store(batch);
+        }
+        return true;
+    }
+
+    template <typename Func>
+    void measure(const char * name, const Problem & problem, Func && func) {
+        if (!this->filter_.empty() && this->filter_ != name)
+            return;
+
+        typedef std::chrono::steady_clock clock;
+        size_t ops = 1024;
+        double elapsed;
+        for (;;) {
+            clock::time_point start_time = clock::now();
+            func(ops);
+            std::chrono::duration<double> duration = clock::now() - start_time;
+            elapsed = duration.count();
+            if (elapsed >= this->min_case_time_ || ops >= (size_t(1) << 32))
+                break;
+            ops *= 2;
+        }
+
+        printf("{\"bench\":\"%s\",\"goods\":%u,\"total\":\"%s\",\"ops\":%llu,\"ns_per_op\":%0.3f}\n",
+               name, (uint32_t)problem.goods.size(), problem.total_amount.to_string().c_str(),
+               (unsigned long long)ops, elapsed * 1.0e9 / (double)ops);
+        fflush(stdout);
+    }
+
+    void run_problem(const Problem & problem) {
+        InvoiceBalance balance;
+        this->prepare(balance, problem);
+
+        RandomGenerator random(this->seed_);
+        SearchCandidate candidate;
+        balance.load_candidate(candidate);
+        CandidateBatch batch;
+        balance.init_candidate_batch(batch);
+        if (!this->fill_batch(candidate, random, batch)) {
+            fprintf(stderr, " InvoiceBench: no candidate for %u goods, total = %s\n",
+                    (uint32_t)problem.goods.size(), problem.total_amount.to_string().c_str());
+            return;
+        }
+
+        this->measure("draw_prices", problem, [&](size_t ops) {
+            int64_t sum = 0;
+            for (size_t i = 0; i < ops; i++) {
+                candidate.draw_prices(random);
+                sum += candidate.price(i % candidate.size());
+            }
+            this->sink_ = sum;
+        });
+
+        // The counts of the last drawn prices, drawn again in a new order each time.
+        this->measure("draw_counts", problem, [&](size_t ops) {
+            int64_t sum = 0;
+            for (size_t i = 0; i < ops; i++) {
+                sum += candidate.draw_counts(random) ? 1 : 0;
+            }
+            this->sink_ = sum;
+        });
+
+        // The kernel that the search selected for this CPU, one op is a full batch of candidates.
+        BatchKernel batch_kernel = balance.get_batch_kernel();
+        this->measure("batch_kernel", problem, [&](size_t ops) {
+            double sum = 0.0;
+            for (size_t i = 0; i < ops; i++) {
+                batch_kernel(batch);
+                sum += batch.errors[i % CandidateBatch::kBatchSize];
+            }
+            this->sink_ = (int64_t)sum;
+        });
+
+        this->measure("normal_dist_random_i32", problem, [&](size_t ops) {
+            int64_t sum = 0;
+            for (size_t i = 0; i < ops; i++) {
+                sum += random.normal_dist_random_i32(1, 1000);
+            }
+            this->sink_ = sum;
+        });
+
+        this->measure("next_random_box_muller", problem, [&](size_t ops) {
+            double sum = 0.0;
+            for (size_t i = 0; i < ops; i++) {
+                sum += random.next_random_box_muller(0.0, 1.0);
+            }
+            this->sink_ = (int64_t)sum;
+        });
+
+        // The restarts of search_price_and_amount(), ops is the number of restarts.
+        this->measure("search_restart", problem, [&](size_t ops) {
+            InvoiceBalance search;
+            this->prepare(search, problem);
+            size_t done = 0;
+            while (done < ops) {
+                // A perfect answer stops the search early, start it over.
+                done += search.run_random_restarts(ops - done);
+            }
+            this->sink_ = (int64_t)done;
+        });
+    }
+};
+
+const size_t InvoiceBench::kGoodsCounts[] = { 2, 3, 5, 8, 12, 20, 0 };
+const double InvoiceBench::kTotalAmounts[] = { 1000.0, 120000.0, 10000000.0, 0.0 };
+
+int main(int argc, char * argv[])
+{
+    uint64_t seed = 1;
+    std::string filter;
+    bool quick = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--seed" && i + 1 < argc)
+            seed = (uint64_t)strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--filter" && i + 1 < argc)
+            filter = argv[++i];
+        else if (arg == "--quick")
+            quick = true;
+        else {
+            fprintf(stderr, " Usage: InvoiceBench [--seed N] [--filter NAME] [--quick]\n");
+            return -1;
+        }
+    }
+
+    InvoiceBench bench(seed, filter, quick);
+    bench.run();
+    return 0;
+}